@@ -30,6 +30,16 @@ public:
 	{
 		return ((push_index_ + 1) % size) == pop_index_;
 	}
+	/** Number of elements in the buffer. */
+	uint8_t Count() const
+	{
+		return (push_index_ + size - pop_index_) % size;
+	}
+	/** Number of elements that can be pushed before the buffer is full. */
+	uint8_t Free() const
+	{
+		return size - 1 - Count();
+	}
 
 	/** Push element \c e into buffer.
 	 * \return true on success, false on failure.
@@ -0,0 +1,99 @@
+#ifndef CPool_h_
+#define	CPool_h_
+/*
+vim: ts=2
+vim: shiftwidth=2
+*/
+
+#include <stdint.h>					// uint8_t
+#include <avr/io.h>					// SREG
+#include <avr/interrupt.h>	// cli
+
+/**
+ * Fixed-block pool: \c size blocks of type \c E, E being a plain struct.
+ * Alloc and Free are O(1) and can be called both from interrupts and the main loop.
+ * A block may be allocated in one context and freed in another; ownership passes with the pointer.
+ */
+template <class E, int size>
+class CPool {
+public:
+	/** Initialize pool, all blocks free. */
+	CPool()
+	: free_(0), available_(size), low_water_(size), exhausted_(0)
+	{
+		for (uint8_t i=0; i<size; ++i) {
+			blocks_[i].next = free_;
+			free_ = &blocks_[i];
+		}
+	}
+
+	/** Allocate a block.
+	 * \return Block, or 0 when the pool is exhausted.
+	 */
+	E* Alloc()
+	{
+		const uint8_t	sreg = SREG;
+		cli();
+		Block*				b = free_;
+		if (b) {
+			free_ = b->next;
+			--available_;
+			if (available_ < low_water_) {
+				low_water_ = available_;
+			}
+		} else {
+			++exhausted_;
+		}
+		SREG = sreg;
+		return b ? &b->element : 0;
+	}
+
+	/** Return a block to the pool. \c e must have been allocated from this pool. */
+	void Free(	E*	e)
+	{
+		Block*				b = reinterpret_cast<Block*>(e);
+		const uint8_t	sreg = SREG;
+		cli();
+		b->next = free_;
+		free_ = b;
+		++available_;
+		SREG = sreg;
+	}
+
+	/** Number of free blocks. */
+	uint8_t Available() const
+	{
+		return available_;
+	}
+	/** Smallest number of free blocks seen. */
+	uint8_t LowWater() const
+	{
+		return low_water_;
+	}
+	/** Number of failed allocations. */
+	uint16_t Exhausted() const
+	{
+		return exhausted_;
+	}
+private:
+	/** Block, either free or in use. */
+	union Block {
+		/** Next free block. */
+		Block*	next;
+		/** Element. */
+		E				element;
+	};
+
+	/** Blocks. */
+	Block							blocks_[size];
+	/** First free block. */
+	Block*						free_;
+	/** Number of free blocks. */
+	volatile uint8_t	available_;
+	/** Smallest number of free blocks. */
+	uint8_t						low_water_;
+	/** Number of failed allocations. */
+	uint16_t					exhausted_;
+}; // class CPool
+
+#endif /* CPool_h_ */
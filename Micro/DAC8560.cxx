@@ -0,0 +1,422 @@
+// vim: ts=4 shiftwidth=4
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/CBuffer.h>
+#include <Micro/DAC8560.h>
+#include <Micro/isrtrace.h>
+#include <Micro/shared.h>
+
+// PORTB pin 4
+#define	CS_PIN	4
+
+#define SET_CS()  do {PORTB &= ~(1 << CS_PIN); } while(0)
+#define CLR_CS()  do {PORTB |= (1 << CS_PIN); } while(0)
+
+#define	SPI_Write(data)	do { SPDR = data; while (!(SPSR & (1<<SPIF))) ; } while (0)
+
+#define	STEP_CMD	3
+#define	STEP_MSB	2
+#define	STEP_LSB	1
+#define	STEP_IDLE	0
+
+#if !defined(DAC8560_QUEUE_SIZE)
+/** Number of slots in the queue, one is always unused. */
+#define	DAC8560_QUEUE_SIZE	8
+#endif
+
+static volatile uint8_t		step = STEP_IDLE;
+static volatile uint16_t	dac_out = 0;
+static DAC8560_IRQ_USAGE	irq_usage = DAC8560_WITHOUT_IRQ;
+static DAC8560_TRANSPORT	transport = DAC8560_SPI;
+
+/// Pending values, DAC8560_WITH_IRQ_QUEUED mode.
+static CBuffer<uint16_t, DAC8560_QUEUE_SIZE>	queue;
+/// Pending value, DAC8560_WITH_IRQ_LATEST mode.
+static volatile uint16_t	latest = 0;
+/// Is \c latest valid?
+static volatile bool		latest_pending = false;
+/// Values dropped.
+static uint16_t				dropped = 0;
+/// Values overwritten.
+static uint16_t				overwritten = 0;
+
+#if defined(DAC8560_WITH_USART)
+#if !defined(UMSEL01)
+#error DAC8560_WITH_USART requires USART with Master SPI mode.
+#endif
+
+#if defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__) || defined(__AVR_ATmega324P__) || defined(__AVR_ATmega164P__)
+// XCK0 is PB0.
+#define	XCK_DDR	DDRB
+#define	XCK_BIT	PB0
+#else
+// XCK is PD4: ATmega48/88/168/328.
+#define	XCK_DDR	DDRD
+#define	XCK_BIT	PD4
+#endif
+// TXD0 is PD1 on all of them.
+#define	TXD_DDR	DDRD
+#define	TXD_BIT	PD1
+
+#define	USART_Write(data)	do { while (!(UCSR0A & (1<<UDRE0))) ; UDR0 = data; } while (0)
+
+/*****************************************************************************/
+/** Select DAC and load the whole frame into the transmitter. Must be run with interrupts
+ * disabled, otherwise transmit complete could be signalled in the middle of the frame.
+ */
+static inline void
+usart_start(
+	const uint16_t	Data
+)
+{
+	CLR_CS();
+	USART_Write(0x00);
+	USART_Write((uint8_t)(Data >> 8));
+	USART_Write((uint8_t)(Data & 0xFF));
+	// The last byte is still in the buffer, thus this clears only stale flags.
+	UCSR0A = (1<<TXC0);
+}
+#endif // DAC8560_WITH_USART
+
+/*****************************************************************************/
+/** Select DAC and start the transfer. The rest is done by the interrupt. */
+static inline void
+start_transfer(
+	const uint16_t	Data
+)
+{
+#if defined(DAC8560_WITH_USART)
+	if (transport == DAC8560_USART_SPI) {
+		usart_start(Data);
+		// One interrupt per frame.
+		step = STEP_LSB;
+		return;
+	}
+#endif
+	CLR_CS();
+	dac_out = Data;
+	step = STEP_CMD;
+	SPDR = 0x00;
+}
+
+/*****************************************************************************/
+/** Start transfer of the next pending value, if any. Called by the interrupt when idle. */
+static inline void
+chain_next()
+{
+	uint16_t	next;
+	switch (irq_usage) {
+	case DAC8560_WITH_IRQ_QUEUED:
+		if (queue.Pop(next)) {
+			start_transfer(next);
+		}
+		break;
+	case DAC8560_WITH_IRQ_LATEST:
+		if (latest_pending) {
+			latest_pending = false;
+			start_transfer(latest);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/*****************************************************************************/
+/* SPI Serial Transfer Complete */
+ISR(SPI_STC_vect)
+{
+	ISRTRACE_ENTER(ISRTRACE_SPI_STC);
+	if (step>0) {
+		switch (step) {
+		case STEP_CMD:
+			SPDR = (uint8_t)(dac_out >> 8);
+			break;
+		case STEP_MSB:
+			SPDR = (uint8_t)(dac_out & 0xFF);
+			break;
+		case STEP_LSB:
+			SET_CS();
+			break;
+		}
+		--step;
+
+		if (step == STEP_IDLE) {
+			chain_next();
+		}
+	}
+	ISRTRACE_EXIT();
+}
+
+#if defined(DAC8560_WITH_USART)
+/*****************************************************************************/
+/* USART Transmit Complete: the whole frame has been shifted out. */
+#if defined(USART0_TX_vect)
+ISR(USART0_TX_vect)
+#else
+ISR(USART_TX_vect)
+#endif
+{
+	ISRTRACE_ENTER(ISRTRACE_DAC_USART_TX);
+	if (step != STEP_IDLE) {
+		SET_CS();
+		step = STEP_IDLE;
+		chain_next();
+	}
+	ISRTRACE_EXIT();
+}
+#endif // DAC8560_WITH_USART
+
+/*****************************************************************************/
+void
+DAC8560_Init(
+	const DAC8560_IRQ_USAGE	dac8560_irq_usage
+)
+{
+	DAC8560_InitTransport(DAC8560_SPI, dac8560_irq_usage);
+}
+
+/*****************************************************************************/
+void
+DAC8560_InitTransport(
+	const DAC8560_TRANSPORT	dac8560_transport,
+	const DAC8560_IRQ_USAGE	dac8560_irq_usage
+)
+{
+	irq_usage = dac8560_irq_usage;
+	transport = dac8560_transport;
+	uint16_t	discard;
+	while (queue.Pop(discard))
+		;
+	latest_pending = false;
+	dropped = 0;
+	overwritten = 0;
+
+#if defined(DAC8560_WITH_USART)
+	if (transport == DAC8560_USART_SPI) {
+		// 1. Port setup.
+		DDRB |= (1 << CS_PIN);
+		XCK_DDR |= (1 << XCK_BIT);
+		TXD_DDR |= (1 << TXD_BIT);
+
+		// 2. USART setup, baud rate must be set after the transmitter is enabled.
+		UBRR0 = 0;
+		// Master SPI, MSB first, SCK is low when idle, leading edge is setup.
+		UCSR0C = (1<<UMSEL01) | (1<<UMSEL00) | (1<<UCPHA0);
+		UCSR0B =
+			  (irq_usage != DAC8560_WITHOUT_IRQ
+				? (1 << TXCIE0)
+				: 0 )
+			| (1<<TXEN0);
+		// Clock frequency is 1/2 of CPU freq.
+		UBRR0 = 0;
+		return;
+	}
+#endif
+
+	// 1. Port setup.
+	DDRB |= (1 << CS_PIN) | (1<<PB5) | (1<<PB7);
+
+	// 2. SPI setup.
+	SPSR = (1 << SPI2X);
+	// interrupts disabled, SPI enabled, MSB first, Master
+	// SCK is low when idle, leading edge is setup, clock frequency is 1/4 of CPU freq.
+	SPCR =
+		  (irq_usage != DAC8560_WITHOUT_IRQ
+		   	? (1 << SPIE)
+			: 0 )
+		| (1<<SPE)
+		| (1<<MSTR)
+		| (1<<CPHA); // 0x54;
+}
+
+/*****************************************************************************/
+void
+DAC8560_Write (
+	const uint16_t	Data)
+{
+	uint8_t	sreg;
+
+	switch (irq_usage) {
+	case DAC8560_WITH_IRQ:
+		sreg = SREG;
+		cli();
+		if (step == STEP_IDLE) {
+			// 1. start writing.
+			start_transfer(Data);
+		} else {
+			++dropped;
+		}
+		SREG = sreg;
+		break;
+	case DAC8560_WITH_IRQ_QUEUED:
+		// The interrupt must not go idle between the check and the push.
+		sreg = SREG;
+		cli();
+		if (step == STEP_IDLE) {
+			start_transfer(Data);
+		} else if (!queue.Push(Data)) {
+			++dropped;
+		}
+		SREG = sreg;
+		break;
+	case DAC8560_WITH_IRQ_LATEST:
+		sreg = SREG;
+		cli();
+		if (step == STEP_IDLE) {
+			start_transfer(Data);
+		} else {
+			if (latest_pending) {
+				++overwritten;
+			}
+			latest = Data;
+			latest_pending = true;
+		}
+		SREG = sreg;
+		break;
+	case DAC8560_WITHOUT_IRQ:
+#if defined(DAC8560_WITH_USART)
+		if (transport == DAC8560_USART_SPI) {
+			sreg = SREG;
+			cli();
+			usart_start(Data);
+			SREG = sreg;
+			while (!(UCSR0A & (1<<TXC0)))
+				;
+			SET_CS();
+			break;
+		}
+#endif
+		CLR_CS();
+		SPI_Write(0);
+		SPI_Write(Data >> 8);
+		SPI_Write(Data & 0x00FF);
+		SET_CS();
+		break;
+	}
+}
+
+/*****************************************************************************/
+bool
+DAC8560_Busy(void)
+{
+	switch (irq_usage) {
+	case DAC8560_WITH_IRQ:
+	case DAC8560_WITH_IRQ_QUEUED:
+	case DAC8560_WITH_IRQ_LATEST:
+		return step != STEP_IDLE;
+	case DAC8560_WITHOUT_IRQ:
+		return false;
+	}
+	return false;
+}
+
+/*****************************************************************************/
+uint16_t
+DAC8560_Dropped(void)
+{
+	return shared_load16(&dropped);
+}
+
+/*****************************************************************************/
+uint16_t
+DAC8560_Overwritten(void)
+{
+	return shared_load16(&overwritten);
+}
+
+#if defined(DAC8560_BENCHMARK)
+#if defined(TIMSK1)
+#define	BENCHMARK_TIMSK	TIMSK1
+#define	BENCHMARK_TIFR	TIFR1
+#else
+#define	BENCHMARK_TIMSK	TIMSK
+#define	BENCHMARK_TIFR	TIFR
+#endif
+/// Timer1 interrupt enables, masked during a measurement.
+#define	BENCHMARK_TIMSK_BITS	((1<<OCIE1A) | (1<<OCIE1B) | (1<<TOIE1))
+/// Timer1 flags, cleared after a measurement unless set before it.
+#define	BENCHMARK_TIFR_BITS		((1<<OCF1A) | (1<<OCF1B) | (1<<TOV1))
+
+/*****************************************************************************/
+/** CPU clocks of DAC8560_BENCHMARK_WRITES writes with the given transport and mode. Timer1
+ * counts at F_CPU/8, thus up to 524288 CPU clocks.
+ */
+static uint32_t
+benchmark(
+	const DAC8560_TRANSPORT	dac8560_transport,
+	const DAC8560_IRQ_USAGE	dac8560_irq_usage
+)
+{
+	DAC8560_InitTransport(dac8560_transport, dac8560_irq_usage);
+
+	const uint8_t	sreg = SREG;
+	cli();
+	const uint8_t	timsk = BENCHMARK_TIMSK;
+	const uint8_t	tifr = BENCHMARK_TIFR & BENCHMARK_TIFR_BITS;
+	const uint8_t	tccr1a = TCCR1A;
+	const uint8_t	tccr1b = TCCR1B;
+	const uint16_t	tcnt1 = TCNT1;
+	BENCHMARK_TIMSK = timsk & ~BENCHMARK_TIMSK_BITS;
+	TCCR1A = 0x00;
+	TCCR1B = 0x00;
+	TCNT1 = 0;
+	BENCHMARK_TIFR = (1<<TOV1);
+	TCCR1B = (1<<CS11);
+	// The interrupt modes need them.
+	sei();
+
+	for (uint16_t i=0; i<DAC8560_BENCHMARK_WRITES; ++i) {
+		DAC8560_Write(0x8000);
+		while (DAC8560_Busy())
+			;
+	}
+
+	cli();
+	const uint16_t	count = TCNT1;
+	const bool		overflow = (BENCHMARK_TIFR & (1<<TOV1)) != 0;
+	TCCR1B = tccr1b;
+	TCCR1A = tccr1a;
+	TCNT1 = tcnt1;
+	BENCHMARK_TIFR = ~tifr & BENCHMARK_TIFR_BITS;
+	BENCHMARK_TIMSK = timsk;
+	SREG = sreg;
+
+	return overflow ? 0xFFFFFFFFUL : (uint32_t)count * 8;
+}
+
+/*****************************************************************************/
+void
+DAC8560_Benchmark(
+	DAC8560_BENCHMARK_RESULT*	result
+)
+{
+	const DAC8560_TRANSPORT	old_transport = transport;
+	const DAC8560_IRQ_USAGE	old_irq_usage = irq_usage;
+	const uint8_t			spcr = SPCR;
+
+	result->spi_irq = benchmark(DAC8560_SPI, DAC8560_WITH_IRQ);
+	result->spi_blocking = benchmark(DAC8560_SPI, DAC8560_WITHOUT_IRQ);
+	SPCR = spcr;
+
+#if defined(DAC8560_WITH_USART)
+	const uint8_t			ucsr0b = UCSR0B;
+	const uint8_t			ucsr0c = UCSR0C;
+	const uint16_t			ubrr0 = UBRR0;
+
+	result->usart_irq = benchmark(DAC8560_USART_SPI, DAC8560_WITH_IRQ);
+	result->usart_blocking = benchmark(DAC8560_USART_SPI, DAC8560_WITHOUT_IRQ);
+	UCSR0B = 0;
+	UCSR0C = ucsr0c;
+	UBRR0 = ubrr0;
+	UCSR0B = ucsr0b;
+#else
+	result->usart_irq = 0;
+	result->usart_blocking = 0;
+#endif
+
+	DAC8560_InitTransport(old_transport, old_irq_usage);
+}
+#endif // DAC8560_BENCHMARK
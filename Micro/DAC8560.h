@@ -3,18 +3,39 @@
 #define DAC8560_h_
 
 /** \file
- * DAC8560 interface. This is specific to SCALP03G.
+ * DAC8560 interface. This is specific to SCALP03G; see DAC8560T.h for other boards.
  *
  * The physical interface is hardware SPI, chip select is PB4, active high.
  *
  * Software can be configured to either offload data transfer to SPI transfer complete interrupt
- * or send it directly.
+ * or send it directly. When offloading, a write issued during a transfer is handled according
+ * to the mode:
+ * <ol>
+ *   <li>DAC8560_WITH_IRQ: the new value is dropped.
+ *   <li>DAC8560_WITH_IRQ_QUEUED: the new value is queued, the interrupt sends queued values
+ *   back to back. The value is dropped when the queue is full. Queue size is 8 by default;
+ *   define DAC8560_QUEUE_SIZE on the compiler's command line to change it.
+ *   <li>DAC8560_WITH_IRQ_LATEST: only the newest pending value is kept and sent as soon as the
+ *   transfer in progress completes. Older pending values are overwritten.
+ * </ol>
+ *
+ * Alternatively, the DAC can be driven by USART0 in Master SPI mode (DAC8560_USART_SPI): SCK is
+ * XCK0, data is TXD0, chip select remains PB4. The transmitter is double-buffered, thus the
+ * 3-byte frame is sent back to back and the transfer complete interrupt fires once per frame
+ * to release chip select. USART0 cannot be used by the uart module at the same time.
+ * The transport must be enabled by defining DAC8560_WITH_USART on the compiler's command line;
+ * it is available on devices with Master SPI mode USART (ATmega88, ATmega644, etc).
  *
  * Test results for 1024 DAC settings with cpu clock 10MHz, SPI clock 5MHz:
  * With IRQ-s: 22.7 ms
  * Without IRQ-s: 10.24 ms, thus one transmit takes 100 clock cycles or 10uS. At 1kHz repetition
  * rate it consumes 1% of CPU. Not bad.
  *
+ * DAC8560_USART_SPI has NOT been measured yet. Hand-calculated for the same clocks: 48 cycles on
+ * the wire per frame; without IRQ-s about 70 cycles per write (7.2 ms for 1024), with IRQ-s
+ * about 30 cycles in DAC8560_Write plus one interrupt of about 40 cycles. DAC8560_Benchmark
+ * (with -DDAC8560_BENCHMARK) repeats the test above for every transport; replace these figures
+ * with its results.
  */
 
 #include <stdint.h>
@@ -29,9 +50,20 @@ typedef enum {
 	/** Offload data transfer to SPI transfer complete interrupt. */
 	DAC8560_WITH_IRQ,
 	/** Do not offload data transfer. */
-	DAC8560_WITHOUT_IRQ
+	DAC8560_WITHOUT_IRQ,
+	/** Offload data transfer, queue writes issued during a transfer. */
+	DAC8560_WITH_IRQ_QUEUED,
+	/** Offload data transfer, keep the newest write issued during a transfer. */
+	DAC8560_WITH_IRQ_LATEST
 } DAC8560_IRQ_USAGE;
 
+typedef enum {
+	/** SPI peripheral. */
+	DAC8560_SPI,
+	/** USART0 in Master SPI mode. Requires DAC8560_WITH_USART. */
+	DAC8560_USART_SPI
+} DAC8560_TRANSPORT;
+
 /** Initialize DAC port as follows: PB4,PB5,PB7 output.
  * Init SPI to Master, F_CPU/4, MSB first, SCK is low when idle, leading edge is setup.
  *
@@ -42,9 +74,25 @@ DAC8560_Init(
 	const DAC8560_IRQ_USAGE	dac8560_irq_usage
 );
 
-/** Write 16-bit value to DAC unless DAC is busy (see DAC8560_Busy).
+/** Initialize DAC port and the given transport. For DAC8560_SPI, same as DAC8560_Init.
+ * For DAC8560_USART_SPI: PB4, XCK0, TXD0 output. USART0 to Master SPI, F_CPU/2, MSB first,
+ * SCK is low when idle, leading edge is setup.
+ *
+ * \param[in]	dac8560_transport	Peripheral used for data transfer.
+ * \param[in]	dac8560_irq_usage	Whether to offload the data transfer to interrupts.
+ */
+void
+DAC8560_InitTransport(
+	const DAC8560_TRANSPORT	dac8560_transport,
+	const DAC8560_IRQ_USAGE	dac8560_irq_usage
+);
+
+/** Write 16-bit value to DAC. In DAC8560_WITH_IRQ mode the value is dropped when DAC is busy
+ * (see DAC8560_Busy), in the queued and latest modes it is sent when the transfer in progress
+ * completes.
  *
  * If data transfer is offloaded to interrupts, requires interrupt to be enabled.
+ * Interrupts are disabled for a few cycles.
  *
  * \param[in]	Data	16-bit value to be sent to DAC.
  */
@@ -60,6 +108,52 @@ DAC8560_Write(
 bool
 DAC8560_Busy(void);
 
+/** Number of values dropped since DAC8560_Init: DAC busy in DAC8560_WITH_IRQ mode or queue full
+ * in DAC8560_WITH_IRQ_QUEUED mode.
+ */
+uint16_t
+DAC8560_Dropped(void);
+
+/** Number of pending values overwritten by newer ones in DAC8560_WITH_IRQ_LATEST mode since
+ * DAC8560_Init.
+ */
+uint16_t
+DAC8560_Overwritten(void);
+
+#if defined(DAC8560_BENCHMARK)
+/** Number of writes per measurement. */
+#define	DAC8560_BENCHMARK_WRITES	1024
+
+/** CPU clocks taken by DAC8560_BENCHMARK_WRITES writes, each waiting for DAC8560_Busy to clear.
+ * 0xFFFFFFFF when Timer1 overflowed, 0 when not measured.
+ */
+typedef struct {
+	/** DAC8560_SPI, DAC8560_WITH_IRQ. */
+	uint32_t	spi_irq;
+	/** DAC8560_SPI, DAC8560_WITHOUT_IRQ. */
+	uint32_t	spi_blocking;
+	/** DAC8560_USART_SPI, DAC8560_WITH_IRQ; requires DAC8560_WITH_USART. */
+	uint32_t	usart_irq;
+	/** DAC8560_USART_SPI, DAC8560_WITHOUT_IRQ; requires DAC8560_WITH_USART. */
+	uint32_t	usart_blocking;
+} DAC8560_BENCHMARK_RESULT;
+
+/** Time DAC8560_BENCHMARK_WRITES mid-scale writes with every transport and the IRQ and blocking
+ * modes, using Timer1 at F_CPU/8 with its interrupts masked; Timer1 is restored afterwards, do
+ * not run it during an acquisition. Interrupts are enabled during the measurements, other
+ * interrupts count into the results. Results are returned rather than printed because
+ * DAC8560_USART_SPI takes over USART0: the UART must be idle, its registers are restored
+ * afterwards. The DAC is then initialized again with the previous transport and mode.
+ * Main loop only.
+ *
+ * \param[out]	result	CPU clocks per transport and mode.
+ */
+void
+DAC8560_Benchmark(
+	DAC8560_BENCHMARK_RESULT*	result
+);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,234 @@
+// vim: ts=4 shiftwidth=4
+#ifndef DAC8560T_h_
+#define DAC8560T_h_
+
+/** \file
+ * Board-independent DAC8560 driver. Chip select pin, SPI mode and SPI clock divider are
+ * template parameters, thus there is no state in RAM and chip select is a single instruction.
+ * Several DACs can share one SPI bus, each with its own chip select.
+ *
+ * Transfers are blocking: 3 bytes, about 100 CPU clocks at F_CPU/2. For the interrupt-driven
+ * modes of SCALP03G see DAC8560.h.
+ *
+ * Usage:
+ * \code
+ * MICRO_PIN(Cs0, PORTB, DDRB, PINB, 4);
+ * MICRO_PIN(Cs1, PORTB, DDRB, PINB, 3);
+ * typedef SpiBus<1, 2>				Bus;	// SPI mode 1, F_CPU/2.
+ * typedef DAC8560T<Bus, Cs0, true>	Dac0;	// Chip select active high (inverted on board).
+ * typedef DAC8560T<Bus, Cs1, false>	Dac1;
+ * typedef DAC8560Group<Dac0, Dac1>	Dacs;
+ *
+ * Bus::Init();
+ * Dacs::Init();
+ * Dac0::Write(0x8000);
+ * const uint16_t	codes[] = { 0x1000, 0x2000 };
+ * Dacs::Write(codes);		// Both DACs, back to back.
+ * Dacs::WriteAll(0x8000);	// Both DACs, simultaneously.
+ * \endcode
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/Pin.h>
+
+#if defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__) || defined(__AVR_ATmega324P__) || defined(__AVR_ATmega164P__) \
+	|| defined(__AVR_ATmega16__) || defined(__AVR_ATmega32__)
+/// SPI pins: MOSI, SCK, SS.
+#define	DAC8560T_SPI_PINS	(_BV(PB5) | _BV(PB7) | _BV(PB4))
+#else
+/// SPI pins: MOSI, SCK, SS. ATmega8, ATmega48/88/168/328.
+#define	DAC8560T_SPI_PINS	(_BV(PB3) | _BV(PB5) | _BV(PB2))
+#endif
+
+/**
+ * Hardware SPI master. SS is made an output, otherwise the SPI peripheral could switch to
+ * slave mode.
+ *
+ * \param	spi_mode	SPI mode 0..3: bit 1 is CPOL, bit 0 is CPHA. DAC8560 needs mode 1.
+ * \param	clock_div	SCK divider: 2, 4, 8, 16, 32, 64 or 128.
+ */
+template <uint8_t spi_mode, uint8_t clock_div>
+class SpiBus {
+public:
+	enum {
+		/** SPR1:0 bits of SPCR. */
+		SPR = clock_div <= 4 ? 0 : (clock_div <= 16 ? 1 : (clock_div <= 64 ? 2 : 3)),
+		/** Double speed for 2, 8, 32. */
+		DOUBLE = clock_div == 2 || clock_div == 8 || clock_div == 32,
+		/** SPCR value. */
+		CONTROL = _BV(SPE) | _BV(MSTR)
+			| ((spi_mode & 2) ? _BV(CPOL) : 0)
+			| ((spi_mode & 1) ? _BV(CPHA) : 0)
+			| SPR
+	};
+
+	/** Configure SPI pins and the SPI peripheral. Interrupts disabled, MSB first. */
+	static void Init()
+	{
+		DDRB |= DAC8560T_SPI_PINS;
+		SPSR = DOUBLE ? _BV(SPI2X) : 0;
+		SPCR = CONTROL;
+	}
+
+	/** Send one byte, wait until done.
+	 * \return	Byte received.
+	 */
+	static uint8_t Transfer(
+		const uint8_t	data
+	)
+	{
+		SPDR = data;
+		while (!(SPSR & _BV(SPIF)))
+			;
+		return SPDR;
+	}
+}; // class SpiBus
+
+/**
+ * DAC8560 on a shared SPI bus.
+ *
+ * \param	Bus				SpiBus type.
+ * \param	Cs				Chip select pin type, see MICRO_PIN.
+ * \param	cs_active_high	Is chip select high during transfer? SCALP03G inverts SYNC.
+ */
+template <class Bus, class Cs, bool cs_active_high = false>
+class DAC8560T {
+public:
+	/** Configure chip select pin and deselect. Call Bus::Init too. */
+	static void Init()
+	{
+		Deselect();
+		Cs::Output();
+	}
+
+	/** Write 16-bit value to DAC.
+	 * \param[in]	code	16-bit value.
+	 */
+	static void Write(
+		const uint16_t	code
+	)
+	{
+		Select();
+		Frame(code);
+		Deselect();
+	}
+
+	/** Assert chip select. */
+	static void Select()
+	{
+		if (cs_active_high) {
+			Cs::High();
+		} else {
+			Cs::Low();
+		}
+	}
+
+	/** Release chip select, DAC8560 has been updated at the 24th clock. */
+	static void Deselect()
+	{
+		if (cs_active_high) {
+			Cs::Low();
+		} else {
+			Cs::High();
+		}
+	}
+
+	/** Send the 3-byte frame, chip select is not touched.
+	 * \param[in]	code	16-bit value.
+	 */
+	static void Frame(
+		const uint16_t	code
+	)
+	{
+		// Control byte: normal operation.
+		Bus::Transfer(0x00);
+		Bus::Transfer(code >> 8);
+		Bus::Transfer(code & 0xFF);
+	}
+}; // class DAC8560T
+
+/** Placeholder for unused DAC8560Group slots. */
+struct DAC8560None {
+	static void Init()								{ }
+	static void Write(const uint16_t)				{ }
+	static void Select()							{ }
+	static void Deselect()							{ }
+	static void Frame(const uint16_t)				{ }
+};
+
+/** Is \c D the placeholder? */
+template <class D>
+struct DAC8560IsNone {
+	enum { value = 0 };
+};
+
+template <>
+struct DAC8560IsNone<DAC8560None> {
+	enum { value = 1 };
+};
+
+/**
+ * Up to four DAC8560T on the same bus, updated in one pass.
+ */
+template <class Dac0, class Dac1, class Dac2 = DAC8560None, class Dac3 = DAC8560None>
+class DAC8560Group {
+public:
+	/** Number of DACs in the group. */
+	enum {
+		SIZE = 2 + !DAC8560IsNone<Dac2>::value + !DAC8560IsNone<Dac3>::value
+	};
+
+	/** Configure chip select pins of all DACs. */
+	static void Init()
+	{
+		Dac0::Init();
+		Dac1::Init();
+		Dac2::Init();
+		Dac3::Init();
+	}
+
+	/** Write one value to every DAC; all chip selects are asserted together, thus the outputs
+	 * change at the same instant. Only one frame is sent.
+	 * \param[in]	code	16-bit value.
+	 */
+	static void WriteAll(
+		const uint16_t	code
+	)
+	{
+		Dac0::Select();
+		Dac1::Select();
+		Dac2::Select();
+		Dac3::Select();
+		Dac0::Frame(code);
+		Dac0::Deselect();
+		Dac1::Deselect();
+		Dac2::Deselect();
+		Dac3::Deselect();
+	}
+
+	/** Write a value to each DAC, back to back with interrupts disabled, thus the skew between
+	 * the outputs is one frame (about 10 microseconds at 10 MHz).
+	 * \param[in]	codes	SIZE 16-bit values, in the order of the template parameters.
+	 */
+	static void Write(
+		const uint16_t*	codes
+	)
+	{
+		const uint8_t	sreg = SREG;
+		cli();
+		Dac0::Write(codes[0]);
+		Dac1::Write(codes[1]);
+		if (!DAC8560IsNone<Dac2>::value) {
+			Dac2::Write(codes[2]);
+		}
+		if (!DAC8560IsNone<Dac3>::value) {
+			Dac3::Write(codes[3]);
+		}
+		SREG = sreg;
+	}
+}; // class DAC8560Group
+
+#endif /* DAC8560T_h_ */
@@ -209,3 +209,32 @@ LTC2485_Read(void)
 	return r;
 } // function LTC2485_read
 
+
+/*****************************************************************************/
+uint32_t
+LTC2485_Exchange(
+	const uint8_t	config
+)
+{
+	// Result, four consecutive bytes.
+	uint32_t r = 0;
+
+	I2C_Start();
+	if (I2C_Write(LTC2485_ADDR | I2C_WRITE) == 0) {
+		I2C_Write(config);
+		// Repeated start, the conversion is started by the stop condition.
+		I2C_Start();
+		if (I2C_Write(LTC2485_ADDR | I2C_READ) == 0) {
+			r = I2C_Read(ACK);
+			r =r <<8;
+			r += I2C_Read(ACK);
+			r =r <<8;
+			r += I2C_Read(ACK);
+			r =r <<8;
+			r += I2C_Read(ACK);
+		}
+	}
+	I2C_Stop();
+
+	return r;
+} // function LTC2485_Exchange
@@ -30,6 +30,11 @@ extern "C" {
 /// Speed mode: fast output rate with no autozero
 #define LTC2485_FAST 0b00000001
 
+/** Convert a reading returned by LTC2485_Read or LTC2485_Exchange to a signed value.
+ * Inverting the SIG bit yields two's complement, full scale is +/- 2^31.
+ */
+#define LTC2485_SIGNED(raw) ((int32_t)((raw) ^ 0x80000000UL))
+
 /** Initialize LTC2485 port and start first conversion.
  * \param[in]	scl_port	SCL port (for example, &PORTC).
  * \param[in]	scl_bit		Bit index in the SCL port (for example, 4).
@@ -61,6 +66,19 @@ LTC2485_SetConfig(
 uint32_t
 LTC2485_Read(void);
 
+/** Write ADC configuration register and read the conversion register in one transaction
+ * (write, repeated start, read). The new configuration applies to the conversion started
+ * by this call, the returned reading belongs to the previous configuration.
+ *
+ * Time: 0.6 milliseconds.
+ * \param[in]	config	Bitwise combination of LTC2485_XYZ flags for the next conversion.
+ * \return		24-bit reading. 0 if no conversion result present or LTC2485 missing.
+ */
+uint32_t
+LTC2485_Exchange(
+	const uint8_t	config
+);
+
 #if defined(__cplusplus)
 }
 #endif
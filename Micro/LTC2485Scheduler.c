@@ -0,0 +1,154 @@
+// vim: ts=4 shiftwidth=4
+#include <Micro/LTC2485Scheduler.h>	// ourselves
+#include <Micro/LTC2485.h>
+
+/// Nothing known about the conversion in progress.
+#define	KIND_NONE		0
+/// Fast conversion of the input.
+#define	KIND_FAST		1
+/// Periodic PTAT check, fast.
+#define	KIND_PTAT		2
+/// Calibration: PTAT reference, fast.
+#define	KIND_CAL_PTAT	3
+/// Calibration: autozeroed conversion of the input.
+#define	KIND_CAL_SLOW	4
+/// Calibration: fast conversion of the input, measures the offset.
+#define	KIND_CAL_FAST	5
+
+/*****************************************************************************/
+static uint8_t
+config_of(
+	const LTC2485_SCHEDULER*	sched,
+	const uint8_t				kind
+)
+{
+	switch (kind) {
+	case KIND_PTAT:
+	case KIND_CAL_PTAT:
+		return LTC2485_PTAT | LTC2485_FAST | sched->rejection;
+	case KIND_CAL_SLOW:
+		return LTC2485_VIN | LTC2485_SLOW | sched->rejection;
+	default:
+		return LTC2485_VIN | LTC2485_FAST | sched->rejection;
+	}
+}
+
+/*****************************************************************************/
+static uint8_t
+next_kind(
+	const LTC2485_SCHEDULER*	sched
+)
+{
+	switch (sched->inflight) {
+	case KIND_CAL_PTAT:
+		return KIND_CAL_SLOW;
+	case KIND_CAL_SLOW:
+		return KIND_CAL_FAST;
+	case KIND_NONE:
+		break;
+	default:
+		if (!sched->calibrate && sched->autozero_countdown > 0) {
+			return sched->ptat_interval > 0 && sched->ptat_countdown == 0
+				? KIND_PTAT
+				: KIND_FAST;
+		}
+		break;
+	}
+	// Start calibration.
+	return sched->ptat_interval > 0 ? KIND_CAL_PTAT : KIND_CAL_SLOW;
+}
+
+/*****************************************************************************/
+void
+LTC2485Scheduler_Init(
+	LTC2485_SCHEDULER*	sched,
+	const uint8_t		rejection,
+	const uint16_t		autozero_interval,
+	const uint16_t		ptat_interval,
+	const int32_t		ptat_threshold
+)
+{
+	sched->rejection			= rejection;
+	sched->inflight				= KIND_NONE;
+	sched->calibrate			= true;
+	sched->autozero_interval	= autozero_interval > 0 ? autozero_interval : 1;
+	sched->ptat_interval		= ptat_interval;
+	sched->autozero_countdown	= 0;
+	sched->ptat_countdown		= ptat_interval;
+	sched->ptat_threshold		= ptat_threshold;
+	sched->ptat_calibrated		= 0;
+	sched->slow_reading			= 0;
+	sched->offset				= 0;
+}
+
+/*****************************************************************************/
+bool
+LTC2485Scheduler_Poll(
+	LTC2485_SCHEDULER*	sched,
+	int32_t*			sample
+)
+{
+	const uint8_t	next = next_kind(sched);
+	const uint32_t	raw = LTC2485_Exchange(config_of(sched, next));
+	if (raw == 0) {
+		// Conversion not ready, try again with the same decision.
+		return false;
+	}
+
+	const uint8_t	done = sched->inflight;
+	const int32_t	value = LTC2485_SIGNED(raw);
+	sched->inflight = next;
+	if (next == KIND_CAL_PTAT || next == KIND_CAL_SLOW) {
+		sched->calibrate = false;
+		sched->autozero_countdown = sched->autozero_interval;
+	}
+
+	// KIND_NONE: reading of unknown configuration.
+	bool	r = false;
+	switch (done) {
+	case KIND_CAL_PTAT:
+		sched->ptat_calibrated = value;
+		break;
+	case KIND_PTAT:
+		{
+			const int32_t	change = value - sched->ptat_calibrated;
+			if (change > sched->ptat_threshold || -change > sched->ptat_threshold) {
+				sched->calibrate = true;
+			}
+		}
+		break;
+	case KIND_CAL_SLOW:
+		sched->slow_reading = value;
+		*sample = value;
+		r = true;
+		break;
+	case KIND_CAL_FAST:
+		sched->offset = value - sched->slow_reading;
+		// fall through
+	case KIND_FAST:
+		if (sched->autozero_countdown > 0) {
+			--sched->autozero_countdown;
+		}
+		if (sched->ptat_countdown > 0) {
+			--sched->ptat_countdown;
+		}
+		*sample = value - sched->offset;
+		r = true;
+		break;
+	}
+
+	// Reloaded when the PTAT conversion starts, otherwise the next poll would start another.
+	if (next == KIND_PTAT || next == KIND_CAL_PTAT) {
+		sched->ptat_countdown = sched->ptat_interval;
+	}
+	return r;
+}
+
+/*****************************************************************************/
+void
+LTC2485Scheduler_Calibrate(
+	LTC2485_SCHEDULER*	sched
+)
+{
+	sched->calibrate = true;
+}
@@ -0,0 +1,102 @@
+// vim: ts=4 shiftwidth=4
+#ifndef LTC2485Scheduler_h_
+#define LTC2485Scheduler_h_
+
+/** \file
+ * Speed-mode scheduler for LTC2485. The ADC runs in fast mode (2x output rate, no autozero)
+ * and is periodically switched to slow mode (autozero) to measure the offset of the fast
+ * conversions. The measured offset is subtracted from all subsequent fast samples.
+ *
+ * Calibration is one slow conversion followed by one fast conversion of the input; the
+ * difference between the two is the fast-mode offset. It is started:
+ * <ol>
+ *   <li>before the first fast sample,
+ *   <li>every \c autozero_interval fast samples,
+ *   <li>when the PTAT reading differs from the one taken at the last calibration by more than
+ *   \c ptat_threshold. The PTAT channel is sampled every \c ptat_interval fast samples.
+ * </ol>
+ *
+ * The input is assumed to change slowly compared to two conversion periods.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Initialize LTC2485 by calling <b>LTC2485_Init</b>.
+ *   <li>Initialize the scheduler by calling <b>LTC2485Scheduler_Init</b>.
+ *   <li>Call <b>LTC2485Scheduler_Poll</b> at least once per fast conversion period (67 ms).
+ * </ol>
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Scheduler state, one per ADC. All fields are private to the scheduler. */
+typedef struct {
+	/** Rejection frequency, one of LTC2485_R50, LTC2485_R55, LTC2485_R60. */
+	uint8_t		rejection;
+	/** Kind of the conversion in progress, private to the scheduler. */
+	uint8_t		inflight;
+	/** Is calibration requested? */
+	bool		calibrate;
+	/** Fast samples between calibrations. */
+	uint16_t	autozero_interval;
+	/** Fast samples between PTAT readings. */
+	uint16_t	ptat_interval;
+	/** Fast samples left until the next calibration. */
+	uint16_t	autozero_countdown;
+	/** Fast samples left until the next PTAT reading. */
+	uint16_t	ptat_countdown;
+	/** PTAT change, signed units, that triggers calibration. */
+	int32_t		ptat_threshold;
+	/** PTAT reading at the last calibration. */
+	int32_t		ptat_calibrated;
+	/** Last slow (autozeroed) input reading. */
+	int32_t		slow_reading;
+	/** Offset of fast conversions, signed units. */
+	int32_t		offset;
+} LTC2485_SCHEDULER;
+
+/** Initialize scheduler. The first conversions performed will be a calibration.
+ *
+ * \param[out]	sched				Scheduler state.
+ * \param[in]	rejection			Rejection frequency: LTC2485_R50, LTC2485_R55 or LTC2485_R60.
+ * \param[in]	autozero_interval	Number of fast samples between calibrations, at least 1.
+ * \param[in]	ptat_interval		Number of fast samples between PTAT readings, 0 to disable.
+ * \param[in]	ptat_threshold		PTAT change triggering a calibration, in LTC2485_SIGNED units.
+ */
+void
+LTC2485Scheduler_Init(
+	LTC2485_SCHEDULER*	sched,
+	const uint8_t		rejection,
+	const uint16_t		autozero_interval,
+	const uint16_t		ptat_interval,
+	const int32_t		ptat_threshold
+);
+
+/** Collect the conversion result, if any, and start the next conversion.
+ *
+ * Time: 0.6 milliseconds.
+ * \param[in,out]	sched	Scheduler state.
+ * \param[out]		sample	Offset-corrected input reading in LTC2485_SIGNED units.
+ * \return		true when \c sample is valid, false when no conversion was ready or the
+ * 				conversion was not an input reading (i.e. PTAT).
+ */
+bool
+LTC2485Scheduler_Poll(
+	LTC2485_SCHEDULER*	sched,
+	int32_t*			sample
+);
+
+/** Request calibration at the next poll. */
+void
+LTC2485Scheduler_Calibrate(
+	LTC2485_SCHEDULER*	sched
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LTC2485Scheduler_h_ */
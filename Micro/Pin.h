@@ -0,0 +1,41 @@
+// vim: ts=4 shiftwidth=4
+#ifndef Pin_h_
+#define Pin_h_
+
+/** \file
+ * Compile-time GPIO pins. A pin is a type with static member functions; since port and bit
+ * are constants, each operation compiles to a single sbi/cbi instruction for ports in the
+ * lower I/O space.
+ *
+ * Usage:
+ * \code
+ * MICRO_PIN(DacCs, PORTB, DDRB, PINB, 4);
+ * DacCs::Output();
+ * DacCs::High();
+ * \endcode
+ */
+
+#include <avr/io.h>
+
+/** Define pin type \c name.
+ * \param[in]	name	Name of the type.
+ * \param[in]	port	Port register, for example PORTB.
+ * \param[in]	ddr		Data direction register, for example DDRB.
+ * \param[in]	pin		Input register, for example PINB.
+ * \param[in]	bit		Bit index in the port, 0..7.
+ */
+#define	MICRO_PIN(name, port, ddr, pin, bit)						\
+	struct name {													\
+		/** Configure as output. */									\
+		static void Output()	{ ddr |= _BV(bit); }				\
+		/** Configure as input. */									\
+		static void Input()		{ ddr &= ~_BV(bit); }				\
+		/** Drive high, or enable pullup of an input. */			\
+		static void High()		{ port |= _BV(bit); }				\
+		/** Drive low, or disable pullup of an input. */			\
+		static void Low()		{ port &= ~_BV(bit); }				\
+		/** Read input level. */									\
+		static bool Read()		{ return (pin & _BV(bit)) != 0; }	\
+	}
+
+#endif /* Pin_h_ */
@@ -0,0 +1,257 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/CBuffer.h>
+#include <Micro/shared.h>
+#include <Micro/uart.h>
+#include <Micro/isrtrace.h>
+#include <Micro/acquisition.h>
+
+#if !defined(ACQUISITION_BUFFER_SIZE)
+/** Number of slots in the ring, one is always unused. */
+#define	ACQUISITION_BUFFER_SIZE	16
+#endif
+
+/// Batch start marker.
+#define	BATCH_START		0xA5
+/// Size of a record on the wire.
+#define	RECORD_SIZE		8
+
+/// Least Timer1 clocks from setting the next compare match to the match.
+#define	MARGIN_CLOCKS	2
+
+#if defined(TIMSK1)
+#define	TIMER1_IRQ_ENABLE()		do { TIMSK1 |= _BV(OCIE1A); } while (0)
+#define	TIMER1_IRQ_DISABLE()	do { TIMSK1 &= ~_BV(OCIE1A); } while (0)
+#else
+#define	TIMER1_IRQ_ENABLE()		do { TIMSK |= _BV(OCIE1A); } while (0)
+#define	TIMER1_IRQ_DISABLE()	do { TIMSK &= ~_BV(OCIE1A); } while (0)
+#endif
+
+/*****************************************************************************/
+static CBuffer<ACQUISITION_RECORD, ACQUISITION_BUFFER_SIZE>	ring;
+/// Timer1 clocks per sample.
+static uint16_t				period_clocks = 0;
+/// Time of the scheduled compare match, Timer1 clocks; the low 16 bits are in OCR1A.
+static uint32_t				base = 0;
+/// Timestamp of the last sample.
+static uint32_t				last_timestamp = 0;
+/// Is last_timestamp valid?
+static bool					have_last = false;
+/// Statistics, updated in the interrupt.
+static ACQUISITION_STATS	stats;
+/// Guards stats.
+static SEQLOCK				stats_lock;
+/// Called after each sample.
+static ACQUISITION_HOOK		hook = 0;
+
+/*****************************************************************************/
+static void
+clear_stats()
+{
+	stats.min_interval		= 0xFFFF;
+	stats.max_interval		= 0;
+	stats.total_interval	= 0;
+	stats.intervals			= 0;
+	stats.dropped			= 0;
+	stats.missed			= 0;
+}
+
+/*****************************************************************************/
+ISR(TIMER1_COMPA_vect)
+{
+	// Timer1 clocks since the compare match.
+	uint16_t			late = TCNT1 - (uint16_t)base;
+	ISRTRACE_ENTER_LATENCY(ISRTRACE_TIMER1_COMPA, late * 64);
+	ACQUISITION_RECORD	record;
+
+	// More than a period late, i.e. interrupts were disabled that long: the periods in between
+	// have no sample.
+	uint16_t			missed = 0;
+	while (late >= period_clocks) {
+		late -= period_clocks;
+		base += period_clocks;
+		++missed;
+	}
+	record.timestamp = base + late;
+	record.value = acquisition_sample_callback
+		? acquisition_sample_callback()
+		: 0;
+
+	seqlock_write_begin(&stats_lock);
+	stats.missed += missed;
+	if (have_last) {
+		const uint32_t	dt = record.timestamp - last_timestamp;
+		const uint16_t	interval = dt > 0xFFFF ? 0xFFFF : (uint16_t)dt;
+		if (interval < stats.min_interval) {
+			stats.min_interval = interval;
+		}
+		if (interval > stats.max_interval) {
+			stats.max_interval = interval;
+		}
+		stats.total_interval += interval;
+		++stats.intervals;
+	}
+	last_timestamp = record.timestamp;
+	have_last = true;
+
+	if (!ring.Push(record)) {
+		++stats.dropped;
+	}
+	seqlock_write_end(&stats_lock);
+	if (hook) {
+		hook(&record);
+	}
+
+	// Next compare match. It must be ahead of the counter, otherwise it would come only after the
+	// counter has wrapped; periods which have passed during the sample and the hook are missed.
+	base += period_clocks;
+	missed = 0;
+	for (;;) {
+		const uint16_t	ahead = (uint16_t)base - TCNT1;
+		if (ahead >= MARGIN_CLOCKS && ahead <= period_clocks) {
+			break;
+		}
+		base += period_clocks;
+		++missed;
+	}
+	OCR1A = (uint16_t)base;
+	if (missed > 0) {
+		seqlock_write_begin(&stats_lock);
+		stats.missed += missed;
+		seqlock_write_end(&stats_lock);
+	}
+	ISRTRACE_EXIT();
+}
+
+/*****************************************************************************/
+void
+acquisition_set_hook(
+	const ACQUISITION_HOOK	h
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	hook = h;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+acquisition_start(
+	const uint16_t	period
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+
+	ACQUISITION_RECORD	record;
+	while (ring.Pop(record))
+		;
+	clear_stats();
+	period_clocks = period + 1;
+	base = period_clocks;
+	have_last = false;
+
+	// Normal mode, the counter runs free; OCR1A is advanced by the period at each compare match.
+	// Clock F_CPU/64.
+	TCCR1A = 0x00;
+	TCCR1B = 0x00;
+	TCNT1 = 0;
+	OCR1A = (uint16_t)base;
+#if defined(TIFR1)
+	TIFR1 = _BV(OCF1A);
+#else
+	TIFR = _BV(OCF1A);
+#endif
+	TIMER1_IRQ_ENABLE();
+	TCCR1B = _BV(CS11) | _BV(CS10);
+
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+acquisition_stop(void)
+{
+	TCCR1B = 0x00;
+	TIMER1_IRQ_DISABLE();
+}
+
+/*****************************************************************************/
+bool
+acquisition_pop(
+	ACQUISITION_RECORD*	record
+)
+{
+	return ring.Pop(*record);
+}
+
+/*****************************************************************************/
+static void
+send_u32(
+	const uint32_t	x
+)
+{
+	uart_putchar(x);
+	uart_putchar(x >> 8);
+	uart_putchar(x >> 16);
+	uart_putchar(x >> 24);
+}
+
+/*****************************************************************************/
+uint8_t
+acquisition_drain(
+	const uint8_t	max_records
+)
+{
+	const uint8_t	tx_free = uart_tx_free();
+	if (tx_free < 2 + RECORD_SIZE) {
+		return 0;
+	}
+
+	uint8_t	n = ring.Count();
+	if (n > max_records) {
+		n = max_records;
+	}
+	if (n > (tx_free - 2) / RECORD_SIZE) {
+		n = (tx_free - 2) / RECORD_SIZE;
+	}
+	if (n == 0) {
+		return 0;
+	}
+
+	uart_putchar(BATCH_START);
+	uart_putchar(n);
+	for (uint8_t i=0; i<n; ++i) {
+		const ACQUISITION_RECORD	record = ring.Pop();
+		send_u32(record.timestamp);
+		send_u32(record.value);
+	}
+	return n;
+}
+
+/*****************************************************************************/
+void
+acquisition_get_stats(
+	ACQUISITION_STATS*	s
+)
+{
+	seqlock_read(&stats_lock, s, &stats, sizeof(*s));
+}
+
+/*****************************************************************************/
+void
+acquisition_reset_stats(void)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	clear_stats();
+	have_last = false;
+	SREG = sreg;
+}
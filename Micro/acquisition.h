@@ -0,0 +1,143 @@
+// vim: ts=4 shiftwidth=4
+#ifndef acquisition_h_
+#define acquisition_h_
+
+/** \file
+ * Timer-triggered sample acquisition. Timer1 runs free at F_CPU/64 and OCR1A is advanced by the
+ * period at every compare match, which takes one sample by calling
+ * <b>acquisition_sample_callback</b> and stores it together with a timestamp in a ring buffer.
+ * The main loop drains the ring to the UART in batches.
+ *
+ * Timestamps are in Timer1 clocks (64 CPU clocks) since <b>acquisition_start</b>. When the
+ * interrupt comes more than a period late, or the sample and the hook take longer than the rest
+ * of the period, the periods missed are counted and skipped; the timestamps stay on the grid of
+ * periods. Delays longer than 65536 Timer1 clocks are not detected.
+ *
+ * Batch format on the UART, all multi-byte fields little-endian:
+ * <ol>
+ *   <li>0xA5 - batch start.
+ *   <li>N - number of records in the batch.
+ *   <li>N records of 8 bytes: timestamp (4 bytes), value (4 bytes).
+ * </ol>
+ *
+ * Usage:
+ * <ol>
+ *   <li>Implement <b>acquisition_sample_callback</b>.
+ *   <li>Setup UART by calling <b>uart_setup</b>.
+ *   <li>Start sampling by calling <b>acquisition_start</b> and enable interrupts.
+ *   <li>Call <b>acquisition_drain</b> from the main loop.
+ * </ol>
+ *
+ * Ring size is 16 records by default; define ACQUISITION_BUFFER_SIZE on the compiler's
+ * command line to change it.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Calculate Timer1 period for the given sample rate.
+ * \param[in]	f_cpu	CPU clock, Hz. Use F_CPU, if defined.
+ * \param[in]	hz		Sample rate, Hz. At least 5 Hz at 20 MHz, 3 Hz at 10 MHz; the period must
+ * 						be below 65535.
+ */
+#define	ACQUISITION_PERIOD(f_cpu, hz)	((f_cpu)/((hz)*64l)-1)
+
+/** One sample. */
+typedef struct {
+	/** Time of the sample, Timer1 clocks. */
+	uint32_t	timestamp;
+	/** Value returned by acquisition_sample_callback. */
+	uint32_t	value;
+} ACQUISITION_RECORD;
+
+/** Sampling statistics. Intervals are in Timer1 clocks. */
+typedef struct {
+	/** Shortest interval between consecutive samples. */
+	uint16_t	min_interval;
+	/** Longest interval between consecutive samples. */
+	uint16_t	max_interval;
+	/** Sum of all intervals, divide by \c intervals to get the mean. */
+	uint32_t	total_interval;
+	/** Number of intervals measured. */
+	uint32_t	intervals;
+	/** Number of samples lost because the ring was full. */
+	uint16_t	dropped;
+	/** Number of periods without a sample, the interrupt being late or the previous one too
+	 * long. */
+	uint16_t	missed;
+} ACQUISITION_STATS;
+
+/** Called from the Timer1 compare interrupt to take one sample. It is run with interrupts disabled
+ * and determines the worst-case latency of all other interrupts; LTC2485_Read takes 0.5 milliseconds.
+ *
+ * Implemented by user code. Samples are zero when this function is not implemented.
+ * \return		Sample value.
+ */
+extern uint32_t
+acquisition_sample_callback(void) __attribute__ ((weak));
+
+/** Function called from the Timer1 compare interrupt after each sample has been stored.
+ * \param[in]	record	The sample.
+ */
+typedef void (*ACQUISITION_HOOK)(const ACQUISITION_RECORD* record);
+
+/** Set the function to be called after each sample, for example by controlloop.
+ * \param[in]	hook	Function to be called from the interrupt, NULL to disable.
+ */
+void
+acquisition_set_hook(
+	const ACQUISITION_HOOK	hook
+);
+
+/** Start Timer1 and sampling. Clears the ring and statistics.
+ * \param[in]	period	Timer1 period, use ACQUISITION_PERIOD to calculate one.
+ */
+void
+acquisition_start(
+	const uint16_t	period
+);
+
+/** Stop Timer1 and sampling. Samples in the ring are kept. */
+void
+acquisition_stop(void);
+
+/** Pop one sample from the ring.
+ * \param[out]	record	Sample.
+ * \return		true on success, false when the ring is empty.
+ */
+bool
+acquisition_pop(
+	ACQUISITION_RECORD*	record
+);
+
+/** Send samples from the ring to the UART as one batch. Sends only as many records as fit into
+ * the UART transmit buffer, thus never blocks.
+ * \param[in]	max_records	Maximum number of records in the batch.
+ * \return		Number of records sent.
+ */
+uint8_t
+acquisition_drain(
+	const uint8_t	max_records
+);
+
+/** Get a consistent copy of the sampling statistics.
+ * \param[out]	stats	Statistics.
+ */
+void
+acquisition_get_stats(
+	ACQUISITION_STATS*	stats
+);
+
+/** Reset sampling statistics. */
+void
+acquisition_reset_stats(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* acquisition_h_ */
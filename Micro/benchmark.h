@@ -0,0 +1,88 @@
+// vim: ts=4 shiftwidth=4
+#ifndef benchmark_h_
+#define benchmark_h_
+
+/** \file
+ * CPU clock measurement of code snippets with Timer1, for crc_benchmark and fixed_benchmark.
+ *
+ * <b>BENCHMARK_RUN</b> runs a statement a given number of times with interrupts disabled while
+ * Timer1 counts CPU clocks. Timer1 is the acquisition timebase, thus its mode, counter and
+ * flags are restored before interrupts are enabled again. The clocks per run, including the
+ * loop, are printed with interrupts enabled once the UART transmit buffer has room for the line;
+ * call with interrupts enabled. BENCHMARK_OVERFLOW is printed when the 16-bit counter overflowed,
+ * i.e. the runs took 65536 clocks or more; reduce the count then.
+ *
+ * Usage:
+ * \code
+ * volatile uint8_t	sink = 0;
+ * BENCHMARK_RUN("crc8", 64, crc = crc8_table(crc, i));
+ * \endcode
+ * The statement may use the loop counter \c i, uint8_t.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include <Micro/uart.h>
+
+/// Room in the UART ring for one result line.
+#define	BENCHMARK_LINE		32
+
+/// Printed instead of the clocks when Timer1 overflowed.
+#define	BENCHMARK_OVERFLOW	0xFFFF
+
+#if defined(TIFR1)
+#define	BENCHMARK_TIFR		TIFR1
+#else
+#define	BENCHMARK_TIFR		TIFR
+#endif
+
+/// Timer1 flags which the measurement may set, cleared afterwards unless set before.
+#define	BENCHMARK_TIFR_BITS	((1<<OCF1A) | (1<<TOV1))
+
+/** Print one result when the UART ring has room for it. Internal use only. */
+static inline void
+benchmark_print(
+	PGM_P			name,
+	const uint16_t	clocks
+)
+{
+	while (uart_tx_free() < BENCHMARK_LINE) {
+	}
+	println_u16(name, clocks);
+}
+
+/** Run the statement given as the last argument \c count times, 1..255, and print the CPU
+ * clocks per run prefixed by \c name, a string literal.
+ */
+#define	BENCHMARK_RUN(name, count, ...)									\
+	do {																\
+		const uint8_t	sreg = SREG;									\
+		cli();															\
+		const uint8_t	tccr1a = TCCR1A;								\
+		const uint8_t	tccr1b = TCCR1B;								\
+		const uint16_t	tcnt1 = TCNT1;									\
+		const uint8_t	tifr = BENCHMARK_TIFR & BENCHMARK_TIFR_BITS;	\
+		TCCR1A = 0x00;													\
+		TCCR1B = (1<<CS10);												\
+		TCNT1 = 0;														\
+		BENCHMARK_TIFR = (1<<TOV1);										\
+		for (uint8_t i=0; i<(count); ++i) {								\
+			__VA_ARGS__;												\
+		}																\
+		const uint16_t	clocks = TCNT1;									\
+		const bool		overflow = (BENCHMARK_TIFR & (1<<TOV1)) != 0;	\
+		TCCR1B = tccr1b;												\
+		TCCR1A = tccr1a;												\
+		TCNT1 = tcnt1;													\
+		BENCHMARK_TIFR = ~tifr & BENCHMARK_TIFR_BITS;					\
+		SREG = sreg;													\
+		benchmark_print(PSTR(name), overflow								\
+			? BENCHMARK_OVERFLOW										\
+			: clocks / (count));										\
+	} while (0)
+
+#endif /* benchmark_h_ */
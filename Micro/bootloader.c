@@ -0,0 +1,193 @@
+// vim: ts=4 shiftwidth=4
+#include <Micro/frame.h>
+#include <Micro/crc.h>
+#include <Micro/bootloader.h>	// ourselves
+
+/// Largest chunk of data per write.
+#define	CHUNK	((FRAME_MAX_PAYLOAD - 2 < BOOT_MAX_CHUNK ? FRAME_MAX_PAYLOAD - 2 : BOOT_MAX_CHUNK) & ~1)
+
+/// Page programming stages.
+enum {
+	STAGE_IDLE = 0,
+	STAGE_ERASE,
+	STAGE_WRITE
+};
+
+static FRAME_DECODER	dec;
+/// Is dec.frame a request waiting to be processed?
+static volatile bool	ready = false;
+/// Node address.
+static uint8_t			node = 0;
+/// Flash page size.
+static uint16_t			page_size = 0;
+/// End of application flash.
+static uint16_t			app_end = 0;
+/// Page being filled.
+static uint16_t			fill_page = 0;
+/// Bytes of fill_page filled so far, 0 when none.
+static uint16_t			fill_offset = 0;
+/// Page being programmed.
+static uint16_t			program_page = 0;
+/// Programming stage of program_page.
+static uint8_t			stage = STAGE_IDLE;
+/// Has a request for this node been received?
+static bool				active = false;
+
+/*****************************************************************************/
+void
+bootloader_init(
+	const uint8_t	node_address,
+	const uint16_t	page,
+	const uint16_t	end
+)
+{
+	frame_decoder_init(&dec);
+	ready = false;
+	node = node_address;
+	page_size = page;
+	app_end = end;
+	fill_offset = 0;
+	stage = STAGE_IDLE;
+	active = false;
+}
+
+/*****************************************************************************/
+void
+bootloader_input(
+	const uint8_t	c
+)
+{
+	if (!ready && frame_decode(&dec, c)) {
+		ready = true;
+	}
+}
+
+/*****************************************************************************/
+static void
+reply(
+	const uint8_t	command,
+	const uint8_t*	payload,
+	const uint8_t	length
+)
+{
+	if (dec.frame.address != FRAME_BROADCAST) {
+		frame_send(bootloader_port_putchar, node, command | BOOT_REPLY, payload, length);
+	}
+}
+
+/*****************************************************************************/
+/** Handle BOOT_CMD_WRITE. */
+static uint8_t
+write_chunk(
+	const FRAME*	f
+)
+{
+	if (f->length < 2 + 2) {
+		return BOOT_BAD_LENGTH;
+	}
+	const uint16_t	address = f->payload[0] | ((uint16_t)f->payload[1] << 8);
+	const uint8_t	n = f->length - 2;
+	const uint16_t	offset = address & (page_size - 1);
+	const uint16_t	page = address - offset;
+
+	if ((n & 1) != 0 || n > CHUNK) {
+		return BOOT_BAD_LENGTH;
+	}
+	if ((address & 1) != 0
+		|| (uint32_t)address + n > app_end
+		|| offset + n > page_size
+		|| (offset != 0 && (page != fill_page || offset != fill_offset))) {
+		return BOOT_BAD_ADDRESS;
+	}
+
+	fill_page = page;
+	bootloader_port_fill(address, f->payload + 2, n);
+	fill_offset = offset + n;
+	if (fill_offset == page_size) {
+		// Page complete: erase now, write when the erase is done.
+		bootloader_port_erase(page);
+		program_page = page;
+		stage = STAGE_ERASE;
+		fill_offset = 0;
+	}
+	return BOOT_OK;
+}
+
+/*****************************************************************************/
+uint8_t
+bootloader_poll(void)
+{
+	// Advance page programming.
+	if (stage != STAGE_IDLE && !bootloader_port_busy()) {
+		if (stage == STAGE_ERASE) {
+			bootloader_port_write(program_page);
+			stage = STAGE_WRITE;
+		} else {
+			stage = STAGE_IDLE;
+		}
+	}
+
+	// Requests are processed when no page is being programmed; meanwhile the next one waits.
+	if (!ready || stage != STAGE_IDLE) {
+		return active ? BOOTLOADER_ACTIVE : BOOTLOADER_IDLE;
+	}
+
+	const FRAME*	f = &dec.frame;
+	uint8_t			r = BOOTLOADER_IDLE;
+	uint8_t			answer[7];
+
+	if (f->address == node || f->address == FRAME_BROADCAST) {
+		active = true;
+		answer[0] = BOOT_OK;
+		switch (f->command) {
+		case BOOT_CMD_PING:
+			answer[1] = BOOT_VERSION;
+			answer[2] = page_size & 0xFF;
+			answer[3] = page_size >> 8;
+			answer[4] = page_size < CHUNK ? page_size : CHUNK;
+			answer[5] = app_end & 0xFF;
+			answer[6] = app_end >> 8;
+			reply(f->command, answer, 7);
+			break;
+		case BOOT_CMD_WRITE:
+			answer[0] = write_chunk(f);
+			answer[1] = f->payload[0];
+			answer[2] = f->payload[1];
+			reply(f->command, answer, 3);
+			break;
+		case BOOT_CMD_CRC:
+			if (f->length != 2) {
+				answer[0] = BOOT_BAD_LENGTH;
+				reply(f->command, answer, 1);
+			} else {
+				const uint16_t	length = f->payload[0] | ((uint16_t)f->payload[1] << 8);
+				uint16_t		crc = CRC16_INIT;
+				if (length > app_end) {
+					answer[0] = BOOT_BAD_ADDRESS;
+				} else {
+					for (uint16_t a=0; a<length; ++a) {
+						crc = crc16_byte(crc, bootloader_port_read(a));
+					}
+				}
+				answer[1] = crc & 0xFF;
+				answer[2] = crc >> 8;
+				reply(f->command, answer, 3);
+			}
+			break;
+		case BOOT_CMD_RUN:
+			reply(f->command, answer, 1);
+			r = BOOTLOADER_RUN;
+			break;
+		default:
+			answer[0] = BOOT_BAD_COMMAND;
+			reply(f->command, answer, 1);
+			break;
+		}
+	}
+	ready = false;
+
+	if (r == BOOTLOADER_RUN) {
+		return r;
+	}
+	return active ? BOOTLOADER_ACTIVE : BOOTLOADER_IDLE;
+}
@@ -0,0 +1,143 @@
+// vim: ts=4 shiftwidth=4
+#ifndef bootloader_h_
+#define bootloader_h_
+
+/** \file
+ * Serial bootloader for UART and RS485 links, protocol and core. The core is portable: the AVR
+ * port is bootloader_avr.c, the host simulation is host/bootsim.cxx; host/bootflash.cxx is the
+ * programmer, see "make flash-serial".
+ *
+ * Requests and replies are frames (see frame.h) addressed to one node or broadcast. A node
+ * replies only to requests addressed to it, with the same command plus BOOT_REPLY; the first
+ * payload byte of every reply is a status, BOOT_OK on success. The node address is the last
+ * EEPROM byte, or BOOTLOADER_NODE when that is unprogrammed.
+ * <ol>
+ *   <li>BOOT_CMD_PING: no payload. Reply: status, version, page size (2 bytes), largest chunk of
+ *   data per write (1 byte), end of application flash (2 bytes).
+ *   <li>BOOT_CMD_WRITE: byte address (2 bytes), data. The chunks of a page must be sent in order
+ *   from the start of the page; the page is programmed when its last byte has been received.
+ *   Reply: status, address (2 bytes).
+ *   <li>BOOT_CMD_CRC: length (2 bytes). Reply: status, CRC-16 of application flash from address 0
+ *   (2 bytes), after all pages have been programmed.
+ *   <li>BOOT_CMD_RUN: no payload. Reply: status; then the application is started.
+ * </ol>
+ *
+ * Page writes are pipelined: the reply to a write is sent as soon as the chunk has been copied to
+ * the page buffer; a finished page is erased and written while the next chunk is received.
+ * The programmer waits for each reply before sending the next request. Broadcast writes are not
+ * answered, the programmer must wait for the page write time instead and verify every node with
+ * BOOT_CMD_CRC afterwards.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Protocol version. */
+#define	BOOT_VERSION		1
+
+/** Ping. */
+#define	BOOT_CMD_PING		0x01
+/** Write a chunk of a page. */
+#define	BOOT_CMD_WRITE		0x02
+/** CRC-16 of application flash. */
+#define	BOOT_CMD_CRC		0x03
+/** Start the application. */
+#define	BOOT_CMD_RUN		0x04
+/** Added to the command in replies. */
+#define	BOOT_REPLY			0x80
+
+/** Success. */
+#define	BOOT_OK				0x00
+/** Address out of range, not aligned, or out of order. */
+#define	BOOT_BAD_ADDRESS	0x01
+/** Payload too short or too long. */
+#define	BOOT_BAD_LENGTH		0x02
+/** Unknown command. */
+#define	BOOT_BAD_COMMAND	0x03
+
+/** Largest chunk of data per write request. */
+#define	BOOT_MAX_CHUNK		128
+
+/** Result of bootloader_poll. */
+enum {
+	/** Nothing received yet. */
+	BOOTLOADER_IDLE = 0,
+	/** A request addressed to this node has been received. */
+	BOOTLOADER_ACTIVE,
+	/** BOOT_CMD_RUN has been received and answered; start the application. */
+	BOOTLOADER_RUN
+};
+
+/** Initialize the core.
+ * \param[in]	node		Node address, 0..254.
+ * \param[in]	page_size	Flash page size, bytes, a power of two.
+ * \param[in]	app_end		End of application flash, first byte of the bootloader.
+ */
+void
+bootloader_init(
+	const uint8_t	node,
+	const uint16_t	page_size,
+	const uint16_t	app_end
+);
+
+/** Feed a received byte to the core. Call from the UART receive interrupt. Bytes arriving while
+ * a request is being processed are dropped.
+ */
+void
+bootloader_input(
+	const uint8_t	c
+);
+
+/** Process a received request and advance page programming. Call from the main loop.
+ * \return		BOOTLOADER_IDLE, BOOTLOADER_ACTIVE or BOOTLOADER_RUN.
+ */
+uint8_t
+bootloader_poll(void);
+
+/** Port: fill the page buffer at \c address with \c length bytes (even). Called only when the
+ * port is not busy.
+ */
+void
+bootloader_port_fill(
+	const uint16_t	address,
+	const uint8_t*	data,
+	const uint8_t	length
+);
+
+/** Port: start erasing the page at \c address. */
+void
+bootloader_port_erase(
+	const uint16_t	address
+);
+
+/** Port: start writing the page buffer to the page at \c address. */
+void
+bootloader_port_write(
+	const uint16_t	address
+);
+
+/** Port: is an erase or write in progress? */
+bool
+bootloader_port_busy(void);
+
+/** Port: read a byte of application flash. Called only when the port is not busy. */
+uint8_t
+bootloader_port_read(
+	const uint16_t	address
+);
+
+/** Port: send a byte. */
+void
+bootloader_port_putchar(
+	const uint8_t	c
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* bootloader_h_ */
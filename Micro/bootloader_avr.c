@@ -0,0 +1,188 @@
+// vim: ts=4 shiftwidth=4
+/** \file
+ * AVR port of the serial bootloader (see bootloader.h), and its main program. Link with
+ * bootloader.c, frame.c, crc.c and uart.cxx, at the start of the boot section, and program the
+ * BOOTRST fuse so that it runs at reset. Example for ATmega644 with a 4 KB boot section:
+ * \code
+ * make NAME=boot MCU=atmega644 MICRO=.. MSRC="bootloader_avr.c bootloader.c frame.c crc.c uart.cxx" \
+ *   CFLAGS="-DF_CPU=10000000UL -DBOOTLOADER_START=0xF000 -DFRAME_MAX_PAYLOAD=130" \
+ *   LDFLAGS="-Wl,--section-start=.text=0xF000"
+ * \endcode
+ *
+ * At reset the bootloader waits BOOTLOADER_TIMEOUT_MS (default 1000) for a request addressed to
+ * it; without one it starts the application, if there is one. Once addressed, it stays until
+ * BOOT_CMD_RUN. The application can enter the bootloader by jumping to BOOTLOADER_START with
+ * interrupts disabled.
+ *
+ * UART at BOOTLOADER_BAUD (default 38400); for RS485 define UART_RS485_PORT and UART_RS485_PIN as
+ * for the uart driver. Node address: last EEPROM byte, or BOOTLOADER_NODE (default 1) when that
+ * is 0xFF.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+#include <Micro/uart.h>
+#include <Micro/bootloader.h>
+
+#if !defined(BOOTLOADER_START)
+#error Define BOOTLOADER_START, the byte address of the boot section.
+#endif
+
+#if !defined(BOOTLOADER_BAUD)
+/** Baud rate. */
+#define	BOOTLOADER_BAUD			38400
+#endif
+
+#if !defined(BOOTLOADER_NODE)
+/** Node address when none is stored in EEPROM. */
+#define	BOOTLOADER_NODE			1
+#endif
+
+#if !defined(BOOTLOADER_TIMEOUT_MS)
+/** Time to wait for a request after reset. */
+#define	BOOTLOADER_TIMEOUT_MS	1000
+#endif
+
+#if defined(GICR)
+#define	VECTOR_CONTROL	GICR
+#else
+#define	VECTOR_CONTROL	MCUCR
+#endif
+
+/*****************************************************************************/
+void
+uart_read_callback(
+	const uint8_t	c
+)
+{
+	bootloader_input(c);
+}
+
+/*****************************************************************************/
+void
+bootloader_port_fill(
+	const uint16_t	address,
+	const uint8_t*	data,
+	const uint8_t	length
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	if ((address & (SPM_PAGESIZE - 1)) == 0) {
+		// New page: clear the page buffer, which accepts each word only once.
+		boot_rww_enable();
+	}
+	for (uint8_t i=0; i<length; i+=2) {
+		boot_page_fill(address + i, data[i] | ((uint16_t)data[i + 1] << 8));
+	}
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+bootloader_port_erase(
+	const uint16_t	address
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	boot_page_erase(address);
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+bootloader_port_write(
+	const uint16_t	address
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	boot_page_write(address);
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+bool
+bootloader_port_busy(void)
+{
+	return boot_spm_busy();
+}
+
+/*****************************************************************************/
+uint8_t
+bootloader_port_read(
+	const uint16_t	address
+)
+{
+	if (boot_rww_busy()) {
+		const uint8_t	sreg = SREG;
+		cli();
+		boot_rww_enable();
+		SREG = sreg;
+	}
+	return pgm_read_byte(address);
+}
+
+/*****************************************************************************/
+void
+bootloader_port_putchar(
+	const uint8_t	c
+)
+{
+	uart_putchar(c);
+}
+
+/*****************************************************************************/
+static void
+start_application(void)
+{
+	// Let the last reply go out: wait for the 128-byte transmit ring to empty.
+	while (uart_tx_free() < 127) {
+	}
+	_delay_ms(2);
+
+	cli();
+	uart_close();
+	boot_rww_enable();
+	VECTOR_CONTROL = (1<<IVCE);
+	VECTOR_CONTROL = 0;
+	((void (*)(void))0)();
+}
+
+/*****************************************************************************/
+int
+main(void)
+{
+	cli();
+	// Interrupt vectors to the boot section.
+	VECTOR_CONTROL = (1<<IVCE);
+	VECTOR_CONTROL = (1<<IVSEL);
+
+	const uint8_t	stored = eeprom_read_byte((const uint8_t*)E2END);
+	uart_setup(UART_BAUD_RATE_DIVISOR(F_CPU, BOOTLOADER_BAUD));
+	bootloader_init(stored != 0xFF ? stored : BOOTLOADER_NODE, SPM_PAGESIZE, BOOTLOADER_START);
+	sei();
+
+	const bool	have_application = pgm_read_word(0) != 0xFFFF;
+	uint16_t	ms = 0;
+	for (;;) {
+		const uint8_t	status = bootloader_poll();
+		if (status == BOOTLOADER_RUN) {
+			break;
+		}
+		if (status == BOOTLOADER_IDLE) {
+			if (ms >= BOOTLOADER_TIMEOUT_MS && have_application) {
+				break;
+			}
+			_delay_ms(1);
+			++ms;
+		}
+	}
+	start_application();
+	return 0;
+}
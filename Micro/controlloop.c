@@ -0,0 +1,289 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/LTC2485.h>
+#include <Micro/DAC8560.h>
+#include <Micro/acquisition.h>
+#include <Micro/shared.h>
+#include <Micro/controlloop.h>	// ourselves
+
+/// Limit of each PID term, output units * 256. Keeps the sum within int32_t.
+#define	TERM_LIMIT	(1L << 28)
+
+/// Active parameters, used by the interrupt.
+static CONTROLLOOP_PARAMS	params;
+/// Parameters written through registers, applied on commit.
+static CONTROLLOOP_PARAMS	shadow;
+/// Integral, output units * 256.
+static int32_t				integral = 0;
+/// Previous measurement, for the derivative.
+static int32_t				previous = 0;
+/// Is \c previous valid?
+static bool					have_previous = false;
+/// Last measurement.
+static int32_t				measurement = 0;
+/// Last output.
+static uint16_t				output = 0;
+/// Is the loop running?
+static bool					running = false;
+/// Statistics, updated in the interrupt.
+static CONTROLLOOP_STATS	stats;
+/// Guards stats.
+static SEQLOCK				stats_lock;
+
+/*****************************************************************************/
+static int32_t
+limit(
+	const int32_t	x,
+	const int32_t	lo,
+	const int32_t	hi
+)
+{
+	return x < lo ? lo : (x > hi ? hi : x);
+}
+
+/*****************************************************************************/
+/** Controller step, called from the Timer1 compare interrupt after each sample. */
+static void
+step(
+	const ACQUISITION_RECORD*	record
+)
+{
+	const uint16_t	start = TCNT1;
+
+	if (record->value == 0) {
+		// No conversion result.
+		seqlock_write_begin(&stats_lock);
+		++stats.missed;
+		seqlock_write_end(&stats_lock);
+		return;
+	}
+
+	const int32_t	m = LTC2485_SIGNED(record->value) >> params.input_shift;
+	const int32_t	e = limit(params.setpoint - m, -32767, 32767);
+	const int32_t	lo = (int32_t)params.out_min << 8;
+	const int32_t	hi = (int32_t)params.out_max << 8;
+
+	const int32_t	p = limit((int32_t)params.kp * e, -TERM_LIMIT, TERM_LIMIT);
+	const int32_t	d = have_previous
+		? limit((int32_t)params.kd * limit(previous - m, -32767, 32767), -TERM_LIMIT, TERM_LIMIT)
+		: 0;
+	const int32_t	di = (int32_t)params.ki * e;
+	int32_t			u = p + integral + d;
+
+	// Conditional integration: do not wind up against a saturated output.
+	if (!((u >= hi && di > 0) || (u <= lo && di < 0))) {
+		integral = limit(integral + di, lo, hi);
+		u = p + integral + d;
+	}
+	const bool		saturated = u < lo || u > hi;
+	u = limit(u, lo, hi);
+
+	output = (uint16_t)(u >> 8);
+	DAC8560_Write(output);
+	previous = m;
+	have_previous = true;
+	measurement = m;
+
+	const uint16_t	exec = TCNT1 - start;
+	seqlock_write_begin(&stats_lock);
+	if (saturated) {
+		++stats.saturated;
+	}
+	if (exec < stats.exec_min) {
+		stats.exec_min = exec;
+	}
+	if (exec > stats.exec_max) {
+		stats.exec_max = exec;
+	}
+	++stats.steps;
+	seqlock_write_end(&stats_lock);
+}
+
+/*****************************************************************************/
+void
+controlloop_start(
+	const CONTROLLOOP_PARAMS*	p,
+	const uint16_t				period
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	params = *p;
+	shadow = *p;
+	integral = (int32_t)p->out_min << 8;
+	have_previous = false;
+	stats.exec_min = 0xFFFF;
+	stats.exec_max = 0;
+	stats.steps = 0;
+	stats.missed = 0;
+	stats.saturated = 0;
+	running = true;
+	acquisition_set_hook(step);
+	acquisition_start(period);
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+controlloop_stop(void)
+{
+	acquisition_stop();
+	acquisition_set_hook(0);
+	running = false;
+}
+
+/*****************************************************************************/
+void
+controlloop_set_params(
+	const CONTROLLOOP_PARAMS*	p
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	params = *p;
+	shadow = *p;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+controlloop_get_stats(
+	CONTROLLOOP_STATS*	s
+)
+{
+	seqlock_read(&stats_lock, s, &stats, sizeof(*s));
+}
+
+/*****************************************************************************/
+static uint16_t
+set_byte16(
+	const uint16_t	x,
+	const uint8_t	index,
+	const uint8_t	data
+)
+{
+	return index == 0
+		? (x & 0xFF00) | data
+		: (x & 0x00FF) | ((uint16_t)data << 8);
+}
+
+/*****************************************************************************/
+static uint32_t
+set_byte32(
+	const uint32_t	x,
+	const uint8_t	index,
+	const uint8_t	data
+)
+{
+	const uint8_t	shift = index * 8;
+	return (x & ~(0xFFUL << shift)) | ((uint32_t)data << shift);
+}
+
+/*****************************************************************************/
+uint8_t
+controlloop_register_read(
+	const uint8_t	register_no
+)
+{
+	const uint8_t	sreg = SREG;
+	uint32_t		x;
+	uint8_t			base;
+
+	cli();
+	if (register_no < CONTROLLOOP_REG_KI) {
+		x = (uint16_t)shadow.kp;
+		base = CONTROLLOOP_REG_KP;
+	} else if (register_no < CONTROLLOOP_REG_KD) {
+		x = (uint16_t)shadow.ki;
+		base = CONTROLLOOP_REG_KI;
+	} else if (register_no < CONTROLLOOP_REG_SETPOINT) {
+		x = (uint16_t)shadow.kd;
+		base = CONTROLLOOP_REG_KD;
+	} else if (register_no < CONTROLLOOP_REG_OUT_MIN) {
+		x = (uint32_t)shadow.setpoint;
+		base = CONTROLLOOP_REG_SETPOINT;
+	} else if (register_no < CONTROLLOOP_REG_OUT_MAX) {
+		x = shadow.out_min;
+		base = CONTROLLOOP_REG_OUT_MIN;
+	} else if (register_no < CONTROLLOOP_REG_INPUT_SHIFT) {
+		x = shadow.out_max;
+		base = CONTROLLOOP_REG_OUT_MAX;
+	} else if (register_no == CONTROLLOOP_REG_INPUT_SHIFT) {
+		x = shadow.input_shift;
+		base = CONTROLLOOP_REG_INPUT_SHIFT;
+	} else if (register_no == CONTROLLOOP_REG_COMMIT) {
+		x = running ? 1 : 0;
+		base = CONTROLLOOP_REG_COMMIT;
+	} else if (register_no < CONTROLLOOP_REG_MEASUREMENT) {
+		x = output;
+		base = CONTROLLOOP_REG_OUTPUT;
+	} else if (register_no < CONTROLLOOP_REG_EXEC_MAX) {
+		x = (uint32_t)measurement;
+		base = CONTROLLOOP_REG_MEASUREMENT;
+	} else if (register_no < CONTROLLOOP_REG_SATURATED) {
+		x = stats.exec_max;
+		base = CONTROLLOOP_REG_EXEC_MAX;
+	} else if (register_no < CONTROLLOOP_REGISTERS) {
+		x = stats.saturated;
+		base = CONTROLLOOP_REG_SATURATED;
+	} else {
+		x = 0;
+		base = register_no;
+	}
+	SREG = sreg;
+
+	return (uint8_t)(x >> (8 * (register_no - base)));
+}
+
+/*****************************************************************************/
+void
+controlloop_register_write(
+	const uint8_t	register_no,
+	const uint8_t	data
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	switch (register_no) {
+	case CONTROLLOOP_REG_KP:
+	case CONTROLLOOP_REG_KP + 1:
+		shadow.kp = set_byte16(shadow.kp, register_no - CONTROLLOOP_REG_KP, data);
+		break;
+	case CONTROLLOOP_REG_KI:
+	case CONTROLLOOP_REG_KI + 1:
+		shadow.ki = set_byte16(shadow.ki, register_no - CONTROLLOOP_REG_KI, data);
+		break;
+	case CONTROLLOOP_REG_KD:
+	case CONTROLLOOP_REG_KD + 1:
+		shadow.kd = set_byte16(shadow.kd, register_no - CONTROLLOOP_REG_KD, data);
+		break;
+	case CONTROLLOOP_REG_SETPOINT:
+	case CONTROLLOOP_REG_SETPOINT + 1:
+	case CONTROLLOOP_REG_SETPOINT + 2:
+	case CONTROLLOOP_REG_SETPOINT + 3:
+		shadow.setpoint = set_byte32(shadow.setpoint, register_no - CONTROLLOOP_REG_SETPOINT, data);
+		break;
+	case CONTROLLOOP_REG_OUT_MIN:
+	case CONTROLLOOP_REG_OUT_MIN + 1:
+		shadow.out_min = set_byte16(shadow.out_min, register_no - CONTROLLOOP_REG_OUT_MIN, data);
+		break;
+	case CONTROLLOOP_REG_OUT_MAX:
+	case CONTROLLOOP_REG_OUT_MAX + 1:
+		shadow.out_max = set_byte16(shadow.out_max, register_no - CONTROLLOOP_REG_OUT_MAX, data);
+		break;
+	case CONTROLLOOP_REG_INPUT_SHIFT:
+		shadow.input_shift = data & 0x1F;
+		break;
+	case CONTROLLOOP_REG_COMMIT:
+		if (data == 1) {
+			params = shadow;
+			integral = limit(integral, (int32_t)params.out_min << 8, (int32_t)params.out_max << 8);
+		} else if (data == 2) {
+			integral = (int32_t)params.out_min << 8;
+		}
+		break;
+	}
+	SREG = sreg;
+}
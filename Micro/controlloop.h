@@ -0,0 +1,157 @@
+// vim: ts=4 shiftwidth=4
+#ifndef controlloop_h_
+#define controlloop_h_
+
+/** \file
+ * Closed-loop LTC2485 to DAC8560 regulation. Samples are taken by the acquisition module
+ * (Timer1), the controller runs in the same interrupt right after the sample and writes the
+ * output with DAC8560_Write. Loop rate is set by Timer1 only and does not depend on the main loop.
+ *
+ * Controller: fixed-point PID, gains in Q8.8.
+ * <ol>
+ *   <li>measurement = LTC2485_SIGNED(sample) >> input_shift
+ *   <li>error = setpoint - measurement, saturated to 16 bits
+ *   <li>output = (kp * error + integral + kd * -(measurement - previous)) / 256
+ *   <li>integral += ki * error, unless the output is saturated in the direction of the error
+ *   (conditional integration); the integral is clamped to the output range.
+ *   <li>output is clamped to [out_min, out_max].
+ * </ol>
+ * Derivative is taken on the measurement, thus setpoint steps do not kick the output.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Initialize LTC2485 and DAC8560; use DAC8560_WITH_IRQ_LATEST so that the write does not
+ *   block in the interrupt.
+ *   <li>Implement <b>acquisition_sample_callback</b> to return LTC2485_Read().
+ *   <li>Start the loop by calling <b>controlloop_start</b> and enable interrupts.
+ *   <li>Optional: forward <b>twislave_read_callback</b> and <b>twislave_write_callback</b> to
+ *   <b>controlloop_register_read</b> and <b>controlloop_register_write</b>.
+ *   <li>Samples are also stored in the acquisition ring: drain it or ignore its dropped count.
+ * </ol>
+ *
+ * Register map, multi-byte values little-endian. Writes go to shadow parameters and take
+ * effect together when 1 is written to CONTROLLOOP_REG_COMMIT.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Proportional gain, Q8.8, 2 bytes. */
+#define	CONTROLLOOP_REG_KP			0
+/** Integral gain, Q8.8, 2 bytes. */
+#define	CONTROLLOOP_REG_KI			2
+/** Derivative gain, Q8.8, 2 bytes. */
+#define	CONTROLLOOP_REG_KD			4
+/** Setpoint, measurement units, 4 bytes. */
+#define	CONTROLLOOP_REG_SETPOINT	6
+/** Output minimum, DAC code, 2 bytes. */
+#define	CONTROLLOOP_REG_OUT_MIN		10
+/** Output maximum, DAC code, 2 bytes. */
+#define	CONTROLLOOP_REG_OUT_MAX		12
+/** Input shift, 1 byte. */
+#define	CONTROLLOOP_REG_INPUT_SHIFT	14
+/** Write 1: apply shadow parameters. Write 2: reset integral. Read: 1 when running. */
+#define	CONTROLLOOP_REG_COMMIT		15
+/** Read only: last output, 2 bytes. */
+#define	CONTROLLOOP_REG_OUTPUT		16
+/** Read only: last measurement, 4 bytes. */
+#define	CONTROLLOOP_REG_MEASUREMENT	18
+/** Read only: longest controller execution time, Timer1 clocks, 2 bytes. */
+#define	CONTROLLOOP_REG_EXEC_MAX	22
+/** Read only: number of saturated outputs, 2 bytes. */
+#define	CONTROLLOOP_REG_SATURATED	24
+/** Number of registers. */
+#define	CONTROLLOOP_REGISTERS		26
+
+/** Controller parameters. */
+typedef struct {
+	/** Proportional gain, Q8.8. */
+	int16_t		kp;
+	/** Integral gain per sample, Q8.8. */
+	int16_t		ki;
+	/** Derivative gain per sample, Q8.8. */
+	int16_t		kd;
+	/** Setpoint, measurement units. */
+	int32_t		setpoint;
+	/** Output minimum, DAC code. */
+	uint16_t	out_min;
+	/** Output maximum, DAC code. */
+	uint16_t	out_max;
+	/** Right shift from LTC2485_SIGNED to measurement units, 0..31. */
+	uint8_t		input_shift;
+} CONTROLLOOP_PARAMS;
+
+/** Loop statistics. Execution time covers the controller and DAC write, not the ADC read;
+ * see acquisition_get_stats for the loop interval and jitter.
+ */
+typedef struct {
+	/** Shortest execution time, Timer1 clocks. */
+	uint16_t	exec_min;
+	/** Longest execution time, Timer1 clocks. */
+	uint16_t	exec_max;
+	/** Number of controller steps. */
+	uint32_t	steps;
+	/** Number of samples skipped because no conversion was ready. */
+	uint16_t	missed;
+	/** Number of saturated outputs. */
+	uint16_t	saturated;
+} CONTROLLOOP_STATS;
+
+/** Start the loop: reset the controller and start acquisition.
+ * \param[in]	params	Controller parameters.
+ * \param[in]	period	Timer1 period, use ACQUISITION_PERIOD to calculate one.
+ */
+void
+controlloop_start(
+	const CONTROLLOOP_PARAMS*	params,
+	const uint16_t				period
+);
+
+/** Stop acquisition and the loop. The DAC keeps the last output. */
+void
+controlloop_stop(void);
+
+/** Replace controller parameters. The integral is kept.
+ * \param[in]	params	Controller parameters.
+ */
+void
+controlloop_set_params(
+	const CONTROLLOOP_PARAMS*	params
+);
+
+/** Get a consistent copy of the loop statistics.
+ * \param[out]	stats	Statistics.
+ */
+void
+controlloop_get_stats(
+	CONTROLLOOP_STATS*	stats
+);
+
+/** Read loop register, to be called from twislave_read_callback.
+ * \param[in]	register_no	Register number, 0..CONTROLLOOP_REGISTERS-1.
+ * \return		Register contents, 0 for unknown registers.
+ */
+uint8_t
+controlloop_register_read(
+	const uint8_t	register_no
+);
+
+/** Write loop register, to be called from twislave_write_callback.
+ * \param[in]	register_no	Register number, 0..CONTROLLOOP_REGISTERS-1.
+ * \param[in]	data		Data written to the register.
+ */
+void
+controlloop_register_write(
+	const uint8_t	register_no,
+	const uint8_t	data
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* controlloop_h_ */
@@ -0,0 +1,143 @@
+// vim: ts=4 shiftwidth=4
+#ifndef crc_h_
+#define crc_h_
+
+/** \file
+ * CRC-8, CRC-16 and CRC-32, computed incrementally over streamed bytes.
+ * <ol>
+ *   <li>CRC-8: polynomial 0x07, initial value 0, as SMBus PEC. Check value 0xF4.
+ *   <li>CRC-16: CCITT polynomial 0x1021, initial value 0xFFFF, not reflected (CRC-16/CCITT-FALSE).
+ *   Check value 0x29B1.
+ *   <li>CRC-32: IEEE 802.3 polynomial, reflected, initial value and final XOR 0xFFFFFFFF, as in
+ *   zlib. Check value 0xCBF43926.
+ * </ol>
+ * Check values are over the ASCII string "123456789".
+ *
+ * Each CRC is computed by one of three methods, chosen at compile time to trade flash for speed;
+ * tables are in program memory:
+ * <ol>
+ *   <li>CRC_BITWISE: one bit at a time, no table.
+ *   <li>CRC_NIBBLE: 16-entry table, 4 bits at a time. 16, 32 or 64 bytes of flash.
+ *   <li>CRC_TABLE: 256-entry table, 8 bits at a time. 256, 512 or 1024 bytes of flash.
+ * </ol>
+ * Define CRC_METHOD on the compiler's command line to choose the method for all widths (default
+ * CRC_NIBBLE), or CRC8_METHOD, CRC16_METHOD, CRC32_METHOD for one width.
+ *
+ * Portable, also used on the host.
+ *
+ * Usage:
+ * \code
+ * uint16_t	crc = CRC16_INIT;
+ * crc = crc16_update(crc, header, sizeof(header));
+ * crc = crc16_byte(crc, c);
+ * \endcode
+ *
+ * Defining CRC_BENCHMARK compiles all methods and <b>crc_benchmark</b>, which prints CPU clocks per
+ * byte of each method on the UART, measured with Timer1.
+ */
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** One bit at a time. */
+#define	CRC_BITWISE		0
+/** 4 bits at a time, 16-entry table. */
+#define	CRC_NIBBLE		1
+/** 8 bits at a time, 256-entry table. */
+#define	CRC_TABLE		2
+
+#if !defined(CRC_METHOD)
+#define	CRC_METHOD		CRC_NIBBLE
+#endif
+#if !defined(CRC8_METHOD)
+#define	CRC8_METHOD		CRC_METHOD
+#endif
+#if !defined(CRC16_METHOD)
+#define	CRC16_METHOD	CRC_METHOD
+#endif
+#if !defined(CRC32_METHOD)
+#define	CRC32_METHOD	CRC_METHOD
+#endif
+
+/** Initial value of CRC-8. */
+#define	CRC8_INIT		0x00
+/** Initial value of CRC-16. */
+#define	CRC16_INIT		0xFFFF
+/** Initial value of CRC-32. */
+#define	CRC32_INIT		0xFFFFFFFFUL
+/** Final value of CRC-32. */
+#define	CRC32_FINAL(crc)	((crc) ^ 0xFFFFFFFFUL)
+
+/** Update CRC-8 with one byte.
+ * \param[in]	crc		CRC so far, CRC8_INIT at the start.
+ * \param[in]	c		Byte.
+ * \return		Updated CRC.
+ */
+uint8_t
+crc8_byte(
+	const uint8_t	crc,
+	const uint8_t	c
+);
+
+/** Update CRC-8 with \c length bytes. */
+uint8_t
+crc8_update(
+	uint8_t			crc,
+	const void*		data,
+	uint16_t		length
+);
+
+/** Update CRC-16 with one byte.
+ * \param[in]	crc		CRC so far, CRC16_INIT at the start.
+ * \param[in]	c		Byte.
+ * \return		Updated CRC.
+ */
+uint16_t
+crc16_byte(
+	const uint16_t	crc,
+	const uint8_t	c
+);
+
+/** Update CRC-16 with \c length bytes. */
+uint16_t
+crc16_update(
+	uint16_t		crc,
+	const void*		data,
+	uint16_t		length
+);
+
+/** Update CRC-32 with one byte.
+ * \param[in]	crc		CRC so far, CRC32_INIT at the start. Apply CRC32_FINAL at the end.
+ * \param[in]	c		Byte.
+ * \return		Updated CRC.
+ */
+uint32_t
+crc32_byte(
+	const uint32_t	crc,
+	const uint8_t	c
+);
+
+/** Update CRC-32 with \c length bytes. */
+uint32_t
+crc32_update(
+	uint32_t		crc,
+	const void*		data,
+	uint16_t		length
+);
+
+#if defined(CRC_BENCHMARK)
+/** Print CPU clocks per byte of every method on the UART, see benchmark.h. Call with
+ * interrupts enabled.
+ */
+void
+crc_benchmark(void);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* crc_h_ */
@@ -0,0 +1,117 @@
+// vim: ts=4 shiftwidth=4
+#include <Micro/deltacodec.h>	// ourselves
+
+/*****************************************************************************/
+static uint32_t
+zigzag(
+	const int32_t	x
+)
+{
+	return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+/*****************************************************************************/
+static int32_t
+unzigzag(
+	const uint32_t	x
+)
+{
+	return (int32_t)(x >> 1) ^ -(int32_t)(x & 1);
+}
+
+/*****************************************************************************/
+void
+deltacodec_encoder_init(
+	DELTACODEC_ENCODER*	enc,
+	const uint16_t		keyframe_interval
+)
+{
+	enc->last				= 0;
+	enc->keyframe_interval	= keyframe_interval > 0 ? keyframe_interval : 1;
+	enc->countdown			= 0;
+}
+
+/*****************************************************************************/
+uint8_t
+deltacodec_encode(
+	DELTACODEC_ENCODER*	enc,
+	const int32_t		sample,
+	uint8_t*			out
+)
+{
+	uint32_t	token;
+	uint8_t		n = 0;
+
+	if (enc->countdown == 0) {
+		token = (zigzag(sample) << 1) | 1;
+		enc->countdown = enc->keyframe_interval;
+	} else {
+		token = zigzag(sample - enc->last) << 1;
+	}
+	--enc->countdown;
+	enc->last = sample;
+
+	while (token >= 0x80) {
+		out[n] = (uint8_t)token | 0x80;
+		token >>= 7;
+		++n;
+	}
+	out[n] = (uint8_t)token;
+	return n + 1;
+}
+
+/*****************************************************************************/
+void
+deltacodec_encoder_resync(
+	DELTACODEC_ENCODER*	enc
+)
+{
+	enc->countdown = 0;
+}
+
+/*****************************************************************************/
+void
+deltacodec_decoder_init(
+	DELTACODEC_DECODER*	dec
+)
+{
+	dec->last	= 0;
+	dec->token	= 0;
+	dec->shift	= 0;
+	dec->synced	= false;
+}
+
+/*****************************************************************************/
+bool
+deltacodec_decode(
+	DELTACODEC_DECODER*	dec,
+	const uint8_t		c,
+	int32_t*			sample
+)
+{
+	if (dec->shift > 28) {
+		// Overlong token: garbage on the line, wait for a keyframe.
+		dec->token	= 0;
+		dec->shift	= 0;
+		dec->synced	= false;
+	}
+	dec->token |= (uint32_t)(c & 0x7F) << dec->shift;
+	if (c & 0x80) {
+		dec->shift += 7;
+		return false;
+	}
+
+	const uint32_t	token = dec->token;
+	dec->token = 0;
+	dec->shift = 0;
+	if (token & 1) {
+		dec->last = unzigzag(token >> 1);
+		dec->synced = true;
+	} else if (dec->synced) {
+		dec->last += unzigzag(token >> 1);
+	} else {
+		return false;
+	}
+	*sample = dec->last;
+	return true;
+}
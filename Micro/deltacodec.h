@@ -0,0 +1,111 @@
+// vim: ts=4 shiftwidth=4
+#ifndef deltacodec_h_
+#define deltacodec_h_
+
+/** \file
+ * Delta compression of sample streams for the serial link. Portable, used both on the node
+ * (encoder) and on the host (decoder, see host/deltadump.cxx).
+ *
+ * The stream is a sequence of tokens, each token is one varint: 7 bits per byte, least
+ * significant group first, bit 7 set on all but the last byte. The lowest bit of the decoded
+ * token tells its type:
+ * <ol>
+ *   <li>0: delta, token = zigzag(sample - previous) << 1.
+ *   <li>1: keyframe, token = zigzag(sample) << 1 | 1.
+ * </ol>
+ * where zigzag(x) maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+ *
+ * A keyframe is sent every \c keyframe_interval samples, it limits the damage of a lost byte
+ * to the samples up to the next keyframe. Deltas within +/-31 take 1 byte, within +/-4095 take
+ * 2 bytes; a 24-bit keyframe takes 4 bytes.
+ *
+ * Samples must be within +/-2^29, for example 24-bit LTC2485 readings LTC2485_SIGNED(x) >> 8.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Maximum number of bytes per encoded sample. */
+#define	DELTACODEC_MAX_BYTES	5
+
+/** Encoder state. */
+typedef struct {
+	/** Previous sample. */
+	int32_t		last;
+	/** Samples between keyframes. */
+	uint16_t	keyframe_interval;
+	/** Samples left until the next keyframe. */
+	uint16_t	countdown;
+} DELTACODEC_ENCODER;
+
+/** Decoder state. */
+typedef struct {
+	/** Previous sample. */
+	int32_t		last;
+	/** Token being assembled. */
+	uint32_t	token;
+	/** Bit position of the next 7-bit group in \c token. */
+	uint8_t		shift;
+	/** Has a keyframe been received? */
+	bool		synced;
+} DELTACODEC_DECODER;
+
+/** Initialize encoder. The first sample is always a keyframe.
+ * \param[out]	enc					Encoder state.
+ * \param[in]	keyframe_interval	Samples between keyframes, 1 sends keyframes only.
+ */
+void
+deltacodec_encoder_init(
+	DELTACODEC_ENCODER*	enc,
+	const uint16_t		keyframe_interval
+);
+
+/** Encode one sample.
+ * \param[in,out]	enc		Encoder state.
+ * \param[in]		sample	Sample.
+ * \param[out]		out		Encoded bytes, at least DELTACODEC_MAX_BYTES.
+ * \return		Number of bytes stored in \c out.
+ */
+uint8_t
+deltacodec_encode(
+	DELTACODEC_ENCODER*	enc,
+	const int32_t		sample,
+	uint8_t*			out
+);
+
+/** Force a keyframe at the next sample, i.e. after the receiver has been restarted. */
+void
+deltacodec_encoder_resync(
+	DELTACODEC_ENCODER*	enc
+);
+
+/** Initialize decoder. Deltas are ignored until the first keyframe.
+ * \param[out]	dec		Decoder state.
+ */
+void
+deltacodec_decoder_init(
+	DELTACODEC_DECODER*	dec
+);
+
+/** Feed one byte to the decoder.
+ * \param[in,out]	dec		Decoder state.
+ * \param[in]		c		Received byte.
+ * \param[out]		sample	Decoded sample.
+ * \return		true when \c sample is valid.
+ */
+bool
+deltacodec_decode(
+	DELTACODEC_DECODER*	dec,
+	const uint8_t		c,
+	int32_t*			sample
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* deltacodec_h_ */
@@ -0,0 +1,318 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/crc.h>
+#include <Micro/isrtrace.h>
+#include <Micro/eestore.h>	// ourselves
+
+#if !defined(EESTORE_START)
+/** First byte of the area. */
+#define	EESTORE_START	0
+#endif
+
+#if !defined(EESTORE_END)
+/** Last byte of the area. */
+#define	EESTORE_END		E2END
+#endif
+
+/// Number of slots.
+#define	SLOTS			((EESTORE_END + 1 - EESTORE_START) / EESTORE_SLOT_SIZE)
+/// No slot.
+#define	NONE			0xFF
+
+#if SLOTS <= EESTORE_KEYS || SLOTS > 255
+#error eestore needs EESTORE_KEYS + 1 to 255 slots.
+#endif
+
+/// Offsets within a slot.
+#define	OFS_KEY			0
+#define	OFS_SEQ			1
+#define	OFS_LENGTH		5
+#define	OFS_DATA		6
+#define	OFS_CRC			(EESTORE_SLOT_SIZE - 2)
+
+#if defined(EEPE)
+#define	EE_WRITE_ENABLE		EEPE
+#define	EE_MASTER_ENABLE	EEMPE
+#else
+#define	EE_WRITE_ENABLE		EEWE
+#define	EE_MASTER_ENABLE	EEMWE
+#endif
+
+#if !defined(EE_READY_vect) && defined(EE_RDY_vect)
+#define	EE_READY_vect	EE_RDY_vect
+#endif
+
+/// Current slot of each key, NONE when the key has no record.
+static uint8_t			current[EESTORE_KEYS];
+/// Sequence number of the newest record.
+static uint32_t			sequence = 0;
+/// Slot after the newest record.
+static uint8_t			head = 0;
+/// Slots with a bad CRC at init.
+static uint8_t			bad_slots = 0;
+
+/// Slot being written.
+static uint8_t			buffer[EESTORE_SLOT_SIZE];
+/// Slot number being written.
+static uint8_t			write_slot = 0;
+/// Next byte to write.
+static uint8_t			write_pos = 0;
+/// Is a write in progress, until the last byte has been programmed?
+static volatile bool	writing = false;
+
+/*****************************************************************************/
+static uint16_t
+slot_address(
+	const uint8_t	slot
+)
+{
+	return EESTORE_START + (uint16_t)slot * EESTORE_SLOT_SIZE;
+}
+
+/*****************************************************************************/
+/** Read one byte. Waits for a write in progress, interrupts must be disabled. */
+static uint8_t
+ee_read(
+	const uint16_t	address
+)
+{
+	while (EECR & (1<<EE_WRITE_ENABLE)) {
+	}
+	EEAR = address;
+	EECR |= (1<<EERE);
+	return EEDR;
+}
+
+/*****************************************************************************/
+/** Read one byte from the main loop, with interrupts enabled except for the access itself. */
+static uint8_t
+ee_read_main(
+	const uint16_t	address
+)
+{
+	const uint8_t	sreg = SREG;
+	for (;;) {
+		cli();
+		if (!(EECR & (1<<EE_WRITE_ENABLE))) {
+			break;
+		}
+		SREG = sreg;
+	}
+	const uint8_t	r = ee_read(address);
+	SREG = sreg;
+	return r;
+}
+
+/*****************************************************************************/
+static uint32_t
+seq_of(
+	const uint8_t	slot
+)
+{
+	const uint16_t	a = slot_address(slot) + OFS_SEQ;
+	uint32_t		seq = 0;
+	for (uint8_t i=4; i>0; --i) {
+		seq = (seq << 8) | ee_read(a + i - 1);
+	}
+	return seq;
+}
+
+/*****************************************************************************/
+/** Is the slot valid? Interrupts must be disabled. */
+static bool
+slot_valid(
+	const uint8_t	slot
+)
+{
+	const uint16_t	a = slot_address(slot);
+	uint16_t		crc = CRC16_INIT;
+	for (uint8_t i=0; i<OFS_CRC; ++i) {
+		crc = crc16_byte(crc, ee_read(a + i));
+	}
+	return (crc & 0xFF) == ee_read(a + OFS_CRC)
+		&& (crc >> 8) == ee_read(a + OFS_CRC + 1)
+		&& ee_read(a + OFS_LENGTH) <= EESTORE_DATA_SIZE;
+}
+
+/*****************************************************************************/
+uint8_t
+eestore_init(void)
+{
+	bool	have_any = false;
+	uint8_t	newest = 0;
+
+	const uint8_t	sreg = SREG;
+	cli();
+	EECR &= ~(1<<EERIE);
+	writing = false;
+	bad_slots = 0;
+	for (uint8_t k=0; k<EESTORE_KEYS; ++k) {
+		current[k] = NONE;
+	}
+
+	for (uint8_t slot=0; slot<SLOTS; ++slot) {
+		const uint8_t	key = ee_read(slot_address(slot) + OFS_KEY);
+		if (key == 0xFF) {
+			continue;
+		}
+		if (key >= EESTORE_KEYS || !slot_valid(slot)) {
+			++bad_slots;
+			continue;
+		}
+
+		const uint32_t	seq = seq_of(slot);
+		if (current[key] == NONE || seq > seq_of(current[key])) {
+			current[key] = slot;
+		}
+		if (!have_any || seq > sequence) {
+			sequence = seq;
+			newest = slot;
+			have_any = true;
+		}
+	}
+	head = have_any ? (newest + 1) % SLOTS : 0;
+	if (!have_any) {
+		sequence = 0;
+	}
+
+	uint8_t	n = 0;
+	for (uint8_t k=0; k<EESTORE_KEYS; ++k) {
+		if (current[k] != NONE) {
+			// Deleted keys are records of length 0.
+			if (ee_read(slot_address(current[k]) + OFS_LENGTH) > 0) {
+				++n;
+			}
+		}
+	}
+	SREG = sreg;
+	return n;
+}
+
+/*****************************************************************************/
+uint8_t
+eestore_read(
+	const uint8_t	key,
+	void*			data,
+	const uint8_t	size
+)
+{
+	if (key >= EESTORE_KEYS) {
+		return 0;
+	}
+	const uint8_t	slot = current[key];
+	if (slot == NONE) {
+		return 0;
+	}
+
+	const uint16_t	a = slot_address(slot);
+	const uint8_t	length = ee_read_main(a + OFS_LENGTH);
+	uint8_t*		p = (uint8_t*)data;
+	for (uint8_t i=0; i<length && i<size; ++i) {
+		p[i] = ee_read_main(a + OFS_DATA + i);
+	}
+	return length;
+}
+
+/*****************************************************************************/
+/** Is the slot the current record of some key? */
+static bool
+slot_live(
+	const uint8_t	slot
+)
+{
+	for (uint8_t k=0; k<EESTORE_KEYS; ++k) {
+		if (current[k] == slot) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*****************************************************************************/
+bool
+eestore_write(
+	const uint8_t	key,
+	const void*		data,
+	const uint8_t	length
+)
+{
+	if (key >= EESTORE_KEYS || length > EESTORE_DATA_SIZE || eestore_busy()) {
+		return false;
+	}
+
+	// Next slot that holds no current record.
+	while (slot_live(head)) {
+		head = (head + 1) % SLOTS;
+	}
+	write_slot = head;
+	head = (head + 1) % SLOTS;
+	++sequence;
+
+	const uint8_t*	p = (const uint8_t*)data;
+	buffer[OFS_KEY] = key;
+	for (uint8_t i=0; i<4; ++i) {
+		buffer[OFS_SEQ + i] = (uint8_t)(sequence >> (8 * i));
+	}
+	buffer[OFS_LENGTH] = length;
+	for (uint8_t i=0; i<EESTORE_DATA_SIZE; ++i) {
+		buffer[OFS_DATA + i] = i < length ? p[i] : 0xFF;
+	}
+	const uint16_t	crc = crc16_update(CRC16_INIT, buffer, OFS_CRC);
+	buffer[OFS_CRC] = crc & 0xFF;
+	buffer[OFS_CRC + 1] = crc >> 8;
+
+	const uint8_t	sreg = SREG;
+	cli();
+	write_pos = 0;
+	writing = true;
+	EECR |= (1<<EERIE);
+	SREG = sreg;
+	return true;
+}
+
+/*****************************************************************************/
+bool
+eestore_busy(void)
+{
+	return writing;
+}
+
+/*****************************************************************************/
+uint8_t
+eestore_bad_slots(void)
+{
+	return bad_slots;
+}
+
+/*****************************************************************************/
+/** EEPROM ready: write the next byte that differs, or finish the record. */
+ISR(EE_READY_vect)
+{
+	ISRTRACE_ENTER(ISRTRACE_EE_READY);
+	const uint16_t	a = slot_address(write_slot);
+	bool			started = false;
+
+	while (write_pos < EESTORE_SLOT_SIZE && !started) {
+		const uint8_t	pos = write_pos++;
+		if (ee_read(a + pos) != buffer[pos]) {
+			EEAR = a + pos;
+			EEDR = buffer[pos];
+			EECR |= (1<<EE_MASTER_ENABLE);
+			EECR |= (1<<EE_WRITE_ENABLE);
+			started = true;
+		}
+	}
+
+	if (!started) {
+		// All bytes programmed: the record becomes current.
+		EECR &= ~(1<<EERIE);
+		current[buffer[OFS_KEY]] = write_slot;
+		writing = false;
+		if (eestore_written_callback) {
+			eestore_written_callback(buffer[OFS_KEY]);
+		}
+	}
+	ISRTRACE_EXIT();
+}
@@ -0,0 +1,111 @@
+// vim: ts=4 shiftwidth=4
+#ifndef eestore_h_
+#define eestore_h_
+
+/** \file
+ * Journalled, wear-levelled record store in EEPROM, for configuration and calibration: LTC2485
+ * offsets, DAC offsets, the TWI slave address and the like.
+ *
+ * Each record has a key (0..EESTORE_KEYS-1) and up to EESTORE_DATA_SIZE bytes of data. Records
+ * are appended to a ring of fixed-size slots in EEPROM; a new record never overwrites the current
+ * record of any key, so a reset during a write leaves the previous record intact. Slots are
+ * used in turn, which spreads the wear over the whole area.
+ *
+ * Slot layout, EESTORE_SLOT_SIZE bytes (default 16), multi-byte fields little-endian:
+ * <ol>
+ *   <li>key, 0xFF for an empty slot.
+ *   <li>sequence number, 4 bytes; the highest one wins. It does not wrap within the endurance
+ *   of the EEPROM.
+ *   <li>length of data.
+ *   <li>data, EESTORE_DATA_SIZE bytes.
+ *   <li>CRC-16 (see crc.h) over all of the above, 2 bytes.
+ * </ol>
+ *
+ * <b>eestore_init</b> scans the area once and builds an index in RAM, one byte per key; reads
+ * are then O(1). Writes return at once and are completed byte by byte by the EEPROM ready
+ * interrupt, about 3.4 ms per byte changed; bytes that already hold the right value are skipped.
+ * One write may be in progress at a time. A read during a write waits for the byte being written,
+ * at most 3.4 ms per byte read.
+ *
+ * Writing a record of length 0 deletes the key.
+ *
+ * Area: EESTORE_START (default 0) to EESTORE_END (default E2END); at least EESTORE_KEYS + 1 slots,
+ * at most 255. Define these on the compiler's command line to change them.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(EESTORE_SLOT_SIZE)
+/** Slot size, bytes. */
+#define	EESTORE_SLOT_SIZE	16
+#endif
+
+/** Maximum length of data per record. */
+#define	EESTORE_DATA_SIZE	(EESTORE_SLOT_SIZE - 8)
+
+#if !defined(EESTORE_KEYS)
+/** Number of keys. */
+#define	EESTORE_KEYS		8
+#endif
+
+/** Scan the EEPROM area and build the index. Call once at startup, before enabling interrupts.
+ * \return		Number of keys found.
+ */
+uint8_t
+eestore_init(void);
+
+/** Read the current record of a key.
+ * \param[in]	key		Key, 0..EESTORE_KEYS-1.
+ * \param[out]	data	Buffer.
+ * \param[in]	size	Size of the buffer; longer records are truncated.
+ * \return		Length of the record, 0 when there is none.
+ */
+uint8_t
+eestore_read(
+	const uint8_t	key,
+	void*			data,
+	const uint8_t	size
+);
+
+/** Start writing a record. Returns at once; the write is completed by the EEPROM ready interrupt.
+ * The data is copied.
+ * \param[in]	key		Key, 0..EESTORE_KEYS-1.
+ * \param[in]	data	Data.
+ * \param[in]	length	Length of data, 0..EESTORE_DATA_SIZE; 0 deletes the key.
+ * \return		true when started; false when busy or the arguments are out of range.
+ */
+bool
+eestore_write(
+	const uint8_t	key,
+	const void*		data,
+	const uint8_t	length
+);
+
+/** Is a write in progress? */
+bool
+eestore_busy(void);
+
+/** Number of slots with a bad CRC found by eestore_init, i.e. interrupted writes. */
+uint8_t
+eestore_bad_slots(void);
+
+/** Called from the interrupt when a record has been written and has become current.
+ *
+ * Implemented by user code, optionally.
+ * \param[in]	key		Key.
+ */
+extern void
+eestore_written_callback(
+	const uint8_t	key
+) __attribute__ ((weak));
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* eestore_h_ */
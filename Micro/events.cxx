@@ -0,0 +1,163 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include <Micro/CBuffer.h>
+#include <Micro/events.h>
+
+#if !defined(EVENTS_QUEUE_SIZE)
+/** Number of slots per queue, one is always unused. */
+#define	EVENTS_QUEUE_SIZE	8
+#endif
+
+/** Queued event. */
+typedef struct {
+	/** Function to call. */
+	EVENTS_HANDLER	handler;
+	/** Argument to the function. */
+	uint8_t			arg;
+} EVENT;
+
+/*****************************************************************************/
+/// Event queues, by priority. Producers are serialized by disabling interrupts, the only
+/// consumer is the main loop.
+static CBuffer<EVENT, EVENTS_QUEUE_SIZE>	queues[EVENTS_PRIORITIES];
+/// Events lost.
+static uint16_t								dropped = 0;
+
+/*****************************************************************************/
+bool
+events_post(
+	const uint8_t			priority,
+	const EVENTS_HANDLER	handler,
+	const uint8_t			arg
+)
+{
+	EVENT	e;
+	e.handler = handler;
+	e.arg = arg;
+
+	const uint8_t	sreg = SREG;
+	cli();
+	const bool		ok = queues[priority].Push(e);
+	if (!ok) {
+		++dropped;
+	}
+	SREG = sreg;
+	return ok;
+}
+
+/*****************************************************************************/
+static void
+work_expired(
+	void*	arg
+)
+{
+	EVENTS_WORK*	work = (EVENTS_WORK*)arg;
+	events_post(work->priority, work->handler, work->arg);
+}
+
+/*****************************************************************************/
+void
+events_work_setup(
+	EVENTS_WORK*			work,
+	const uint8_t			priority,
+	const EVENTS_HANDLER	handler,
+	const uint8_t			arg
+)
+{
+	timer_setup(&work->timer, work_expired, work);
+	work->handler = handler;
+	work->priority = priority;
+	work->arg = arg;
+}
+
+/*****************************************************************************/
+void
+events_defer(
+	EVENTS_WORK*	work,
+	const uint32_t	delay
+)
+{
+	timer_arm(&work->timer, delay, 0);
+}
+
+/*****************************************************************************/
+void
+events_cancel(
+	EVENTS_WORK*	work
+)
+{
+	timer_cancel(&work->timer);
+}
+
+/*****************************************************************************/
+static bool
+all_empty()
+{
+	for (uint8_t p=0; p<EVENTS_PRIORITIES; ++p) {
+		if (!queues[p].IsEmpty()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*****************************************************************************/
+uint16_t
+events_dispatch(void)
+{
+	uint16_t	n = 0;
+	for (;;) {
+		timer_poll();
+
+		EVENT	e;
+		bool	found = false;
+		for (uint8_t p=0; p<EVENTS_PRIORITIES && !found; ++p) {
+			found = queues[p].Pop(e);
+		}
+		if (!found) {
+			return n;
+		}
+		e.handler(e.arg);
+		++n;
+	}
+}
+
+/*****************************************************************************/
+void
+events_run(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	for (;;) {
+		events_dispatch();
+
+		cli();
+		if (all_empty() && !timer_pending()
+			&& (!events_idle_callback || events_idle_callback())) {
+			// sei() takes effect after the next instruction, thus no wakeup is lost.
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		} else {
+			sei();
+		}
+	}
+}
+
+/*****************************************************************************/
+uint16_t
+events_dropped(void)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	const uint16_t	r = dropped;
+	SREG = sreg;
+	return r;
+}
@@ -0,0 +1,138 @@
+// vim: ts=4 shiftwidth=4
+#ifndef events_h_
+#define events_h_
+
+/** \file
+ * Cooperative run-to-completion event scheduler. Events are posted to one of EVENTS_PRIORITIES
+ * queues (default 3) and dispatched from the main loop by <b>events_run</b>, highest priority
+ * first; a handler always runs to completion before the next event is dispatched.
+ *
+ * Posting is safe from interrupts and from the main loop. When no events are pending,
+ * events_run puts the MCU to SLEEP_MODE_IDLE; any interrupt wakes it. Sleeping is race-free:
+ * an event posted by an interrupt just before sleep wakes the MCU.
+ *
+ * Deferred work items are events posted after a delay by a software timer, see timer.h.
+ *
+ * Usage:
+ * \code
+ * static void on_byte(uint8_t c) { ... }
+ * void uart_read_callback(const uint8_t c) { events_post(EVENTS_PRIORITY_HIGH, on_byte, c); }
+ *
+ * int main() {
+ *   uart_setup(...);
+ *   timer_init();
+ *   sei();
+ *   events_run();	// never returns
+ * }
+ * \endcode
+ *
+ * Queue size is 8 events per priority by default; define EVENTS_QUEUE_SIZE on the compiler's
+ * command line to change it.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <Micro/timer.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(EVENTS_PRIORITIES)
+/** Number of priority levels. */
+#define	EVENTS_PRIORITIES		3
+#endif
+
+/** Highest priority. */
+#define	EVENTS_PRIORITY_HIGH	0
+/** Lowest priority. */
+#define	EVENTS_PRIORITY_LOW		(EVENTS_PRIORITIES - 1)
+
+/** Event handler.
+ * \param[in]	arg		Argument given when the event was posted.
+ */
+typedef void (*EVENTS_HANDLER)(uint8_t arg);
+
+/** Deferred work item: an event posted when the timer expires. All fields are private. */
+typedef struct {
+	/** Timer. */
+	TIMER			timer;
+	/** Handler. */
+	EVENTS_HANDLER	handler;
+	/** Priority. */
+	uint8_t			priority;
+	/** Argument. */
+	uint8_t			arg;
+} EVENTS_WORK;
+
+/** Post an event. Safe to call from interrupts.
+ * \param[in]	priority	Priority, EVENTS_PRIORITY_HIGH..EVENTS_PRIORITY_LOW.
+ * \param[in]	handler		Function to call.
+ * \param[in]	arg			Argument to the function.
+ * \return		true on success, false when the queue is full.
+ */
+bool
+events_post(
+	const uint8_t			priority,
+	const EVENTS_HANDLER	handler,
+	const uint8_t			arg
+);
+
+/** Initialize a deferred work item.
+ * \param[out]	work		Work item.
+ * \param[in]	priority	Priority of the event posted.
+ * \param[in]	handler		Function to call.
+ * \param[in]	arg			Argument to the function.
+ */
+void
+events_work_setup(
+	EVENTS_WORK*			work,
+	const uint8_t			priority,
+	const EVENTS_HANDLER	handler,
+	const uint8_t			arg
+);
+
+/** Post the work item after \c delay ticks. Re-arms a pending work item. Main loop only.
+ * \param[in,out]	work	Work item.
+ * \param[in]		delay	Ticks, at least 1.
+ */
+void
+events_defer(
+	EVENTS_WORK*	work,
+	const uint32_t	delay
+);
+
+/** Cancel a pending work item. Main loop only. */
+void
+events_cancel(
+	EVENTS_WORK*	work
+);
+
+/** Dispatch pending events and expired timers, return when idle.
+ * \return		Number of events dispatched.
+ */
+uint16_t
+events_dispatch(void);
+
+/** Dispatch events forever, sleeping in SLEEP_MODE_IDLE when idle. */
+void
+events_run(void) __attribute__ ((noreturn));
+
+/** Number of events lost because a queue was full. */
+uint16_t
+events_dropped(void);
+
+/** Called by events_run before the MCU goes to sleep, with interrupts disabled. Returning false
+ * skips this sleep, i.e. to poll hardware that cannot interrupt.
+ *
+ * Implemented by user code, optionally.
+ */
+extern bool
+events_idle_callback(void) __attribute__ ((weak));
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* events_h_ */
@@ -0,0 +1,61 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Cycle benchmark of fixedpoint.h against libm float; the library itself is header-only.
+ * Compiled only with -DFIXEDPOINT_BENCHMARK.
+ */
+
+#if defined(FIXEDPOINT_BENCHMARK)
+
+#include <math.h>
+
+#include <Micro/benchmark.h>
+#include <Micro/fixedpoint.h>
+
+/// Calls per measurement.
+#define	BENCHMARK_CALLS			32
+/// Calls per measurement of the slow libm functions, within the 16-bit Timer1 range.
+#define	BENCHMARK_CALLS_LIBM	8
+
+/// Measure one expression, CPU clocks per call including the loop.
+#define	BENCHMARK(name, calls, type, expr)	\
+	BENCHMARK_RUN(name, calls, const type r = (expr); sink ^= *(const uint8_t*)&r)
+
+/// Coefficients of the polynomial benchmark, Q15.
+static const int16_t	poly_coeffs[] PROGMEM = {
+	Q15::Constant(0.125), Q15::Constant(-0.25), Q15::Constant(0.5), Q15::Constant(0.0)
+};
+
+/*****************************************************************************/
+void
+fixed_benchmark(void)
+{
+	// Inputs are volatile, thus not folded into constants.
+	volatile uint8_t	sink = 0;
+	volatile uint16_t	angle = 12345;
+	volatile float		f = 0.7f;
+	volatile int16_t	q15 = 12345;
+	volatile int32_t	q16 = 0x28000L;
+	volatile uint32_t	u32 = 123456789UL;
+
+	BENCHMARK("loop", BENCHMARK_CALLS, uint8_t, i);
+	BENCHMARK("fixed_sin", BENCHMARK_CALLS, Q15, fixed_sin(angle + i));
+	BENCHMARK("sinf", BENCHMARK_CALLS_LIBM, float, sinf(f));
+	BENCHMARK("fixed_isqrt", BENCHMARK_CALLS, uint16_t, fixed_isqrt(u32));
+	BENCHMARK("fixed_sqrt", BENCHMARK_CALLS, Q16_16, fixed_sqrt(Q16_16::FromRaw(q16)));
+	BENCHMARK("sqrtf", BENCHMARK_CALLS_LIBM, float, sqrtf(f));
+	BENCHMARK("fixed_reciprocal", BENCHMARK_CALLS, Q16_16, fixed_reciprocal(Q16_16::FromRaw(q16)));
+	BENCHMARK("1/f", BENCHMARK_CALLS_LIBM, float, 1.0f / f);
+	BENCHMARK("fixed_poly_P cubic", BENCHMARK_CALLS, Q15, fixed_poly_P(poly_coeffs, 4, Q15::FromRaw(q15)));
+	BENCHMARK("float cubic", BENCHMARK_CALLS_LIBM, float, ((0.125f * f - 0.25f) * f + 0.5f) * f);
+	BENCHMARK("Q15 *", BENCHMARK_CALLS, Q15, Q15::FromRaw(q15) * Q15::FromRaw(q15));
+	BENCHMARK("Q16_16 *", BENCHMARK_CALLS, Q16_16, Q16_16::FromRaw(q16) * Q16_16::FromRaw(q16));
+	BENCHMARK("float *", BENCHMARK_CALLS, float, f * f);
+	BENCHMARK("Q16_16 /", BENCHMARK_CALLS, Q16_16, Q16_16::FromRaw(q16) / Q16_16::FromRaw(q15));
+	BENCHMARK("float /", BENCHMARK_CALLS_LIBM, float, f / f);
+}
+
+#endif /* FIXEDPOINT_BENCHMARK */
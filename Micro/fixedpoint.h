@@ -0,0 +1,577 @@
+// vim: ts=4 shiftwidth=4
+#ifndef fixedpoint_h_
+#define fixedpoint_h_
+
+/** \file
+ * Header-only fixed-point arithmetic and lookup tables, for scaling, calibration and waveform
+ * math without floating point.
+ *
+ * Fixed<T, F> is a Q-format number: raw value of type T (int16_t or int32_t) with F fraction bits.
+ * Arithmetic saturates instead of wrapping; multiplication and division round to nearest.
+ * Common formats: Q15 (-1..1), Q8_8 (-128..128), Q31 (-1..1), Q16_16 (-32768..32768).
+ *
+ * Lookup tables are computed by the compiler from a generator (constexpr evaluation, no code or
+ * RAM at run time) and placed in program memory; lookups interpolate linearly between entries.
+ * Generators may use the constexpr functions fixed_cx_sin, fixed_cx_cos, fixed_cx_sqrt,
+ * fixed_cx_exp and fixed_cx_log. avr-gcc evaluates double as 32-bit float by default, thus
+ * tables are exact to about 16 bits.
+ *
+ * Functions and their error against libm (double) as measured by host/fixedpoint over the whole
+ * input range. CPU clocks are not listed: they depend on the compiler and avr-libc version and
+ * have not been measured yet. fixed_benchmark (fixedpoint.cxx, with -DFIXEDPOINT_BENCHMARK)
+ * prints them on the target for each function and for the libm float counterpart in the last
+ * column.
+ * <table>
+ *   <tr><th>Function</th><th>Table</th><th>Max error</th><th>Benchmarked against</th></tr>
+ *   <tr><td>fixed_sin, fixed_cos</td><td>514 bytes</td><td>3.2 LSB Q15, rms 1.3</td><td>sin, cos</td></tr>
+ *   <tr><td>fixed_isqrt</td><td>-</td><td>exact, rounded down</td><td>sqrt</td></tr>
+ *   <tr><td>fixed_sqrt</td><td>-</td><td>1 LSB below 1.0, 3e-5 relative above</td><td>sqrt</td></tr>
+ *   <tr><td>fixed_reciprocal</td><td>258 bytes</td><td>3e-5 relative for |1/x| >= 1, 2 LSB below</td><td>1/x</td></tr>
+ *   <tr><td>fixed_poly_P</td><td>-</td><td>2.5 LSB Q8_8 for a cubic</td><td>-</td></tr>
+ *   <tr><td>Q15 *, Q16_16 /</td><td>-</td><td>0.5 LSB</td><td>*, /</td></tr>
+ * </table>
+ *
+ * Needs C++14 (avr-gcc 5 or later; add -std=gnu++14 to CFLAGS with older defaults). Portable,
+ * also used on the host.
+ *
+ * Usage:
+ * \code
+ * // Thermistor linearisation: 65-entry table of temperature (Q8_8, degrees C) against the
+ * // ADC reading (0..65535), computed at compile time.
+ * struct NtcGen {
+ * 	static constexpr double Eval(double x) {
+ * 		return 256.0 * (1.0 / (1.0 / 298.15 + fixed_cx_log((1.0 - x) / x) / 3950.0) - 273.15);
+ * 	}
+ * };
+ * typedef FixedLut<NtcGen, 6>	Ntc;
+ *
+ * const Q8_8	t = Q8_8::FromRaw(Ntc::Lookup(adc));
+ * const Q15	s = fixed_sin(phase);						// phase: 65536 = one turn.
+ * const Q16_16	gain = Q16_16::FromDouble(1.0123);		// Compile time.
+ * const Q16_16	y = x * gain - Q16_16::FromDouble(0.5);	// Saturating.
+ * \endcode
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 201402L
+#error fixedpoint.h needs C++14.
+#endif
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define	PROGMEM
+#endif
+
+/*****************************************************************************/
+/** Raw type traits: wider type for intermediate results, limits. */
+template <class T>
+struct FixedTraits;
+
+template <>
+struct FixedTraits<int16_t> {
+	typedef int32_t		Wide;
+	static constexpr int16_t Min()	{ return -32767 - 1; }
+	static constexpr int16_t Max()	{ return 32767; }
+	static int16_t Read_P(const int16_t* p)
+	{
+#if defined(__AVR__)
+		return (int16_t)pgm_read_word(p);
+#else
+		return *p;
+#endif
+	}
+};
+
+template <>
+struct FixedTraits<int32_t> {
+	typedef int64_t		Wide;
+	static constexpr int32_t Min()	{ return -2147483647L - 1; }
+	static constexpr int32_t Max()	{ return 2147483647L; }
+	static int32_t Read_P(const int32_t* p)
+	{
+#if defined(__AVR__)
+		return (int32_t)pgm_read_dword(p);
+#else
+		return *p;
+#endif
+	}
+};
+
+/** Saturate a wide value to the raw type. */
+template <class T>
+constexpr T
+fixed_saturate(
+	const typename FixedTraits<T>::Wide	x
+)
+{
+	return x > FixedTraits<T>::Max() ? FixedTraits<T>::Max()
+		: (x < FixedTraits<T>::Min() ? FixedTraits<T>::Min() : (T)x);
+}
+
+/*****************************************************************************/
+/**
+ * Q-format fixed-point number.
+ *
+ * \param	T	Raw type, int16_t or int32_t.
+ * \param	F	Number of fraction bits, less than the number of bits of T.
+ */
+template <class T, uint8_t F>
+class Fixed {
+public:
+	typedef T									Type;
+	typedef typename FixedTraits<T>::Wide		Wide;
+	enum { FRAC = F };
+
+	/** Zero. */
+	constexpr Fixed() : raw_(0) { }
+
+	/** From raw value, without scaling. */
+	static constexpr Fixed FromRaw(const T raw)
+	{
+		return Fixed(raw, 0);
+	}
+
+	/** From an integer, saturated. */
+	static constexpr Fixed FromInt(const int32_t x)
+	{
+		return Fixed(fixed_saturate<T>((Wide)x * ((Wide)1 << F)), 0);
+	}
+
+	/** From double, rounded and saturated. Meant for constants, evaluated at compile time. */
+	static constexpr Fixed FromDouble(const double x)
+	{
+		return Fixed(Constant(x), 0);
+	}
+
+	/** Raw value of a double, rounded and saturated; for PROGMEM tables of coefficients. */
+	static constexpr T Constant(const double x)
+	{
+		return x * ((Wide)1 << F) >= FixedTraits<T>::Max() ? FixedTraits<T>::Max()
+			: (x * ((Wide)1 << F) <= FixedTraits<T>::Min() ? FixedTraits<T>::Min()
+			: (T)(x * ((Wide)1 << F) + (x >= 0 ? 0.5 : -0.5)));
+	}
+
+	/** Largest value. */
+	static constexpr Fixed Max()
+	{
+		return Fixed(FixedTraits<T>::Max(), 0);
+	}
+
+	/** Smallest value. */
+	static constexpr Fixed Min()
+	{
+		return Fixed(FixedTraits<T>::Min(), 0);
+	}
+
+	/** Raw value. */
+	constexpr T Raw() const
+	{
+		return raw_;
+	}
+
+	/** Integer part, rounded towards minus infinity. */
+	constexpr T ToInt() const
+	{
+		return raw_ >> F;
+	}
+
+	/** Value as double; for the host and for tests. */
+	constexpr double ToDouble() const
+	{
+		return (double)raw_ / ((Wide)1 << F);
+	}
+
+	/** Convert to another Q format, rounded and saturated. */
+	template <class Q>
+	constexpr Q To() const
+	{
+		return (uint8_t)Q::FRAC >= F
+			? Q::FromRaw(fixed_saturate<typename Q::Type>(
+				(typename Q::Wide)raw_ * ((typename Q::Wide)1 << ((uint8_t)Q::FRAC - F))))
+			: Q::FromRaw(fixed_saturate<typename Q::Type>(
+				((Wide)raw_ + ((Wide)1 << (F - (uint8_t)Q::FRAC - 1))) >> (F - (uint8_t)Q::FRAC)));
+	}
+
+	constexpr Fixed operator+(const Fixed b) const
+	{
+		return Fixed(fixed_saturate<T>((Wide)raw_ + b.raw_), 0);
+	}
+
+	constexpr Fixed operator-(const Fixed b) const
+	{
+		return Fixed(fixed_saturate<T>((Wide)raw_ - b.raw_), 0);
+	}
+
+	constexpr Fixed operator-() const
+	{
+		return Fixed(fixed_saturate<T>(-(Wide)raw_), 0);
+	}
+
+	constexpr Fixed operator*(const Fixed b) const
+	{
+		return Fixed(fixed_saturate<T>(((Wide)raw_ * b.raw_ + ((Wide)1 << (F - 1))) >> F), 0);
+	}
+
+	/** Division; by zero gives the largest value of the sign of the dividend. */
+	constexpr Fixed operator/(const Fixed b) const
+	{
+		return b.raw_ == 0
+			? (raw_ >= 0 ? Max() : Min())
+			: Fixed(fixed_saturate<T>(
+				(((Wide)raw_ * ((Wide)1 << F)) + ((raw_ < 0) == (b.raw_ < 0) ? b.raw_ / 2 : -b.raw_ / 2)) / b.raw_), 0);
+	}
+
+	/** Multiply by an integer, saturated. */
+	constexpr Fixed Scale(const int16_t k) const
+	{
+		return Fixed(fixed_saturate<T>((Wide)raw_ * k), 0);
+	}
+
+	Fixed& operator+=(const Fixed b)	{ return *this = *this + b; }
+	Fixed& operator-=(const Fixed b)	{ return *this = *this - b; }
+	Fixed& operator*=(const Fixed b)	{ return *this = *this * b; }
+	Fixed& operator/=(const Fixed b)	{ return *this = *this / b; }
+
+	constexpr bool operator==(const Fixed b) const	{ return raw_ == b.raw_; }
+	constexpr bool operator!=(const Fixed b) const	{ return raw_ != b.raw_; }
+	constexpr bool operator<(const Fixed b) const	{ return raw_ < b.raw_; }
+	constexpr bool operator<=(const Fixed b) const	{ return raw_ <= b.raw_; }
+	constexpr bool operator>(const Fixed b) const	{ return raw_ > b.raw_; }
+	constexpr bool operator>=(const Fixed b) const	{ return raw_ >= b.raw_; }
+
+private:
+	constexpr Fixed(const T raw, int) : raw_(raw) { }
+
+	T	raw_;
+};
+
+/** -1..1, 16 bits. */
+typedef Fixed<int16_t, 15>	Q15;
+/** -128..128, 16 bits. */
+typedef Fixed<int16_t, 8>	Q8_8;
+/** -1..1, 32 bits. */
+typedef Fixed<int32_t, 31>	Q31;
+/** -32768..32768, 32 bits. */
+typedef Fixed<int32_t, 16>	Q16_16;
+
+/*****************************************************************************/
+/* Compile-time math for table generators. Not meant for run time. */
+
+/** pi. */
+#define	FIXED_PI	3.14159265358979323846
+
+/** Sine, radians. */
+constexpr double
+fixed_cx_sin(
+	double	x
+)
+{
+	// Reduce to -pi..pi, then Taylor series.
+	const long long	turns = (long long)(x / (2 * FIXED_PI) + (x >= 0 ? 0.5 : -0.5));
+	x -= turns * 2 * FIXED_PI;
+	double	term = x;
+	double	sum = x;
+	for (int n=1; n<14; ++n) {
+		term *= -x * x / ((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+/** Cosine, radians. */
+constexpr double
+fixed_cx_cos(
+	const double	x
+)
+{
+	return fixed_cx_sin(x + FIXED_PI / 2);
+}
+
+/** Square root, x >= 0. */
+constexpr double
+fixed_cx_sqrt(
+	const double	x
+)
+{
+	if (x <= 0) {
+		return 0;
+	}
+	double	y = x >= 1 ? x : 1;
+	for (int i=0; i<64; ++i) {
+		y = 0.5 * (y + x / y);
+	}
+	return y;
+}
+
+/** Natural exponent. */
+constexpr double
+fixed_cx_exp(
+	const double	x
+)
+{
+	// x = k*ln2 + r, |r| <= ln2/2.
+	const double	ln2 = 0.69314718055994530942;
+	const long		k = (long)(x / ln2 + (x >= 0 ? 0.5 : -0.5));
+	const double	r = x - k * ln2;
+	double			term = 1;
+	double			sum = 1;
+	for (int n=1; n<20; ++n) {
+		term *= r / n;
+		sum += term;
+	}
+	for (long i=0; i<k; ++i) {
+		sum *= 2;
+	}
+	for (long i=0; i>k; --i) {
+		sum /= 2;
+	}
+	return sum;
+}
+
+/** Natural logarithm, x > 0. */
+constexpr double
+fixed_cx_log(
+	double	x
+)
+{
+	// x = m*2^k, 1 <= m < 2; log m = 2 atanh((m-1)/(m+1)).
+	const double	ln2 = 0.69314718055994530942;
+	int				k = 0;
+	while (x >= 2) {
+		x /= 2;
+		++k;
+	}
+	while (x < 1) {
+		x *= 2;
+		--k;
+	}
+	const double	z = (x - 1) / (x + 1);
+	double			term = z;
+	double			sum = 0;
+	for (int n=1; n<40; n+=2) {
+		sum += term / n;
+		term *= z * z;
+	}
+	return 2 * sum + k * ln2;
+}
+
+/*****************************************************************************/
+/** Table data computed at compile time: Gen::Eval(i / (SIZE - 1)) for i = 0..SIZE-1, rounded
+ * and saturated to T. */
+template <class Gen, int SIZE, class T>
+struct FixedLutData {
+	T	v[SIZE];
+
+	constexpr FixedLutData() : v()
+	{
+		for (int i=0; i<SIZE; ++i) {
+			const double	y = Gen::Eval((double)i / (SIZE - 1));
+			v[i] = y >= FixedTraits<T>::Max() ? FixedTraits<T>::Max()
+				: (y <= FixedTraits<T>::Min() ? FixedTraits<T>::Min() : (T)(y + (y >= 0 ? 0.5 : -0.5)));
+		}
+	}
+};
+
+/** Interpolated lookup in a PROGMEM table of 2^bits + 1 entries.
+ * \param[in]	table	Table in program memory.
+ * \param[in]	bits	log2 of the number of intervals, 1..8.
+ * \param[in]	x		Position, 0..65535 spans the table; the last entry is at 65536.
+ */
+template <class T>
+inline T
+fixed_interpolate_P(
+	const T*		table,
+	const uint8_t	bits,
+	const uint16_t	x
+)
+{
+	const uint8_t	shift = 16 - bits;
+	const uint16_t	i = x >> shift;
+	// Top 8 bits of the position between entries.
+	const uint8_t	frac = (uint16_t)(x << bits) >> 8;
+	const T			a = FixedTraits<T>::Read_P(table + i);
+	const T			b = FixedTraits<T>::Read_P(table + i + 1);
+	return a + (T)(((typename FixedTraits<T>::Wide)(b - a) * frac + 128) >> 8);
+}
+
+/**
+ * Lookup table of a function over 0..1, computed at compile time and placed in program memory.
+ *
+ * \param	Gen		Generator: struct with <tt>static constexpr double Eval(double x)</tt> returning
+ * 					the raw value for x in 0..1.
+ * \param	BITS	Table has 2^BITS + 1 entries, BITS 1..8.
+ * \param	T		Raw type, int16_t (default) or int32_t.
+ */
+template <class Gen, uint8_t BITS, class T = int16_t>
+class FixedLut {
+public:
+	enum { SIZE = (1 << BITS) + 1 };
+
+	/** Table in program memory. */
+	static const T* Table()
+	{
+		static constexpr FixedLutData<Gen, SIZE, T>	data PROGMEM = FixedLutData<Gen, SIZE, T>();
+		return data.v;
+	}
+
+	/** Interpolated value at x / 65536. */
+	static T Lookup(const uint16_t x)
+	{
+		return fixed_interpolate_P(Table(), BITS, x);
+	}
+};
+
+/*****************************************************************************/
+/** Generator of the sine table: one turn, Q15. */
+struct FixedSineGen {
+	static constexpr double Eval(const double x)
+	{
+		return 32767.0 * fixed_cx_sin(2 * FIXED_PI * x);
+	}
+};
+
+/** Sine.
+ * \param[in]	angle	65536 is one turn.
+ */
+inline Q15
+fixed_sin(
+	const uint16_t	angle
+)
+{
+	return Q15::FromRaw(FixedLut<FixedSineGen, 8>::Lookup(angle));
+}
+
+/** Cosine.
+ * \param[in]	angle	65536 is one turn.
+ */
+inline Q15
+fixed_cos(
+	const uint16_t	angle
+)
+{
+	return fixed_sin(angle + 16384);
+}
+
+/*****************************************************************************/
+/** Integer square root, rounded down. */
+inline uint16_t
+fixed_isqrt(
+	uint32_t	x
+)
+{
+	uint32_t	r = 0;
+	uint32_t	bit = 1UL << 30;
+	while (bit > x) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint16_t)r;
+}
+
+/** Square root; zero for negative values. */
+inline Q16_16
+fixed_sqrt(
+	const Q16_16	x
+)
+{
+	if (x.Raw() <= 0) {
+		return Q16_16();
+	}
+	// sqrt(raw / 2^16) * 2^16 = sqrt(raw << s) << (8 - s/2); largest even s <= 16 that fits.
+	uint32_t	raw = x.Raw();
+	uint8_t		s = 0;
+	while (s < 16 && raw < 0x40000000UL) {
+		raw <<= 2;
+		s += 2;
+	}
+	return Q16_16::FromRaw((int32_t)fixed_isqrt(raw) << (8 - s / 2));
+}
+
+/*****************************************************************************/
+/** Generator of the reciprocal table: 1/m - 1 for m in 0.5..1, Q15 (1/m does not fit). */
+struct FixedReciprocalGen {
+	static constexpr double Eval(const double x)
+	{
+		return 32768.0 / (0.5 + 0.5 * x) - 32768.0;
+	}
+};
+
+/** Reciprocal; saturates for zero and for results out of range. */
+inline Q16_16
+fixed_reciprocal(
+	const Q16_16	x
+)
+{
+	const int32_t	raw = x.Raw();
+	if (raw == 0) {
+		return Q16_16::Max();
+	}
+	// Normalize |raw| to m in 0.5..1 (m16 in 32768..65535), x = m * 2^-k.
+	uint32_t	m = raw < 0 ? -(uint32_t)raw : (uint32_t)raw;
+	int8_t		k = 0;
+	while (m >= 0x10000UL) {
+		m >>= 1;
+		--k;
+	}
+	while (m < 0x8000UL) {
+		m <<= 1;
+		++k;
+	}
+	// 1/m in Q15, 32768..65536; the first entry is saturated, thus m = 0.5 is special.
+	const uint32_t	y = m == 0x8000UL ? 65536UL
+		: 32768UL + (uint16_t)FixedLut<FixedReciprocalGen, 7>::Lookup((uint16_t)((m - 0x8000UL) << 1));
+	// 1/x = 2^k / m; raw = y << (k + 1).
+	const int8_t	shift = k + 1;
+	uint32_t		r;
+	if (shift >= 0) {
+		if (shift > 15 || (y << shift) > 0x7FFFFFFFUL) {
+			return raw < 0 ? Q16_16::Min() : Q16_16::Max();
+		}
+		r = y << shift;
+	} else {
+		r = shift <= -31 ? 0 : (y + (1UL << (-shift - 1))) >> -shift;
+	}
+	return Q16_16::FromRaw(raw < 0 ? -(int32_t)r : (int32_t)r);
+}
+
+/*****************************************************************************/
+/** Polynomial c[0]*x^(n-1) + ... + c[n-1] by Horner's rule, saturating.
+ * \param[in]	coeffs	Raw coefficients in program memory, highest power first, i.e.
+ * 						<tt>static const int16_t c[] PROGMEM = { Q15::Constant(0.1), ... };</tt>
+ * \param[in]	n		Number of coefficients.
+ * \param[in]	x		Argument.
+ */
+template <class Q>
+inline Q
+fixed_poly_P(
+	const typename Q::Type*	coeffs,
+	const uint8_t			n,
+	const Q					x
+)
+{
+	Q	y = Q::FromRaw(FixedTraits<typename Q::Type>::Read_P(coeffs));
+	for (uint8_t i=1; i<n; ++i) {
+		y = y * x + Q::FromRaw(FixedTraits<typename Q::Type>::Read_P(coeffs + i));
+	}
+	return y;
+}
+
+#if defined(FIXEDPOINT_BENCHMARK)
+/** Print CPU clocks of each function and of its libm float counterpart to the UART, see
+ * benchmark.h; 65535 when Timer1 overflowed. Call with interrupts enabled. Defined in
+ * fixedpoint.cxx. */
+void
+fixed_benchmark(void);
+#endif
+
+#endif /* fixedpoint_h_ */
@@ -0,0 +1,115 @@
+// vim: ts=4 shiftwidth=4
+#include <Micro/crc.h>
+#include <Micro/frame.h>	// ourselves
+
+/// Decoder states.
+enum {
+	STATE_SYNC = 0,
+	STATE_ADDRESS,
+	STATE_COMMAND,
+	STATE_LENGTH,
+	STATE_PAYLOAD,
+	STATE_CRC_LO,
+	STATE_CRC_HI
+};
+
+/*****************************************************************************/
+void
+frame_decoder_init(
+	FRAME_DECODER*	dec
+)
+{
+	dec->state = STATE_SYNC;
+	dec->pos = 0;
+	dec->crc = CRC16_INIT;
+	dec->errors = 0;
+}
+
+/*****************************************************************************/
+bool
+frame_decode(
+	FRAME_DECODER*	dec,
+	const uint8_t	c
+)
+{
+	switch (dec->state) {
+	case STATE_SYNC:
+		if (c == FRAME_SYNC) {
+			dec->crc = CRC16_INIT;
+			dec->state = STATE_ADDRESS;
+		}
+		return false;
+	case STATE_ADDRESS:
+		dec->frame.address = c;
+		break;
+	case STATE_COMMAND:
+		dec->frame.command = c;
+		break;
+	case STATE_LENGTH:
+		if (c > FRAME_MAX_PAYLOAD) {
+			++dec->errors;
+			dec->state = STATE_SYNC;
+			return false;
+		}
+		dec->frame.length = c;
+		dec->pos = 0;
+		dec->crc = crc16_byte(dec->crc, c);
+		dec->state = c > 0 ? STATE_PAYLOAD : STATE_CRC_LO;
+		return false;
+	case STATE_PAYLOAD:
+		dec->frame.payload[dec->pos++] = c;
+		dec->crc = crc16_byte(dec->crc, c);
+		if (dec->pos >= dec->frame.length) {
+			dec->state = STATE_CRC_LO;
+		}
+		return false;
+	case STATE_CRC_LO:
+		if (c != (dec->crc & 0xFF)) {
+			++dec->errors;
+			dec->state = STATE_SYNC;
+			return false;
+		}
+		break;
+	case STATE_CRC_HI:
+		dec->state = STATE_SYNC;
+		if (c != (dec->crc >> 8)) {
+			++dec->errors;
+			return false;
+		}
+		return true;
+	}
+
+	if (dec->state < STATE_LENGTH) {
+		dec->crc = crc16_byte(dec->crc, c);
+	}
+	++dec->state;
+	return false;
+}
+
+/*****************************************************************************/
+void
+frame_send(
+	const FRAME_PUTCHAR	put,
+	const uint8_t		address,
+	const uint8_t		command,
+	const void*			payload,
+	const uint8_t		length
+)
+{
+	const uint8_t*	p = (const uint8_t*)payload;
+	uint16_t		crc = CRC16_INIT;
+
+	put(FRAME_SYNC);
+	put(address);
+	crc = crc16_byte(crc, address);
+	put(command);
+	crc = crc16_byte(crc, command);
+	put(length);
+	crc = crc16_byte(crc, length);
+	for (uint8_t i=0; i<length; ++i) {
+		put(p[i]);
+		crc = crc16_byte(crc, p[i]);
+	}
+	put(crc & 0xFF);
+	put(crc >> 8);
+}
@@ -0,0 +1,111 @@
+// vim: ts=4 shiftwidth=4
+#ifndef frame_h_
+#define frame_h_
+
+/** \file
+ * Framed packets for UART and RS485 links. Portable, used both on the node and on the host.
+ *
+ * Frame format, multi-byte fields little-endian:
+ * <ol>
+ *   <li>FRAME_SYNC (0x7E).
+ *   <li>address: node address; FRAME_BROADCAST addresses all nodes.
+ *   <li>command.
+ *   <li>length of the payload, 0..FRAME_MAX_PAYLOAD.
+ *   <li>payload.
+ *   <li>CRC-16 (see crc.h) over address, command, length and payload, 2 bytes.
+ * </ol>
+ * There is no byte stuffing: after a bad CRC or an oversized length, the decoder looks for the
+ * next FRAME_SYNC. The sender should not start a new frame before the previous one has been
+ * answered, or leave a gap.
+ *
+ * Decoder buffer size is FRAME_MAX_PAYLOAD (default 64); define it on the compiler's command
+ * line to change it.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Start of frame. */
+#define	FRAME_SYNC			0x7E
+/** Broadcast address. */
+#define	FRAME_BROADCAST		0xFF
+/** Bytes in a frame besides the payload. */
+#define	FRAME_OVERHEAD		6
+
+#if !defined(FRAME_MAX_PAYLOAD)
+/** Largest payload the decoder accepts, up to 255. */
+#define	FRAME_MAX_PAYLOAD	64
+#endif
+
+/** Decoded frame. */
+typedef struct {
+	/** Address. */
+	uint8_t		address;
+	/** Command. */
+	uint8_t		command;
+	/** Length of the payload. */
+	uint8_t		length;
+	/** Payload. */
+	uint8_t		payload[FRAME_MAX_PAYLOAD];
+} FRAME;
+
+/** Decoder state. All fields except \c frame are private. */
+typedef struct {
+	/** Last frame decoded. */
+	FRAME		frame;
+	/** Decoder state. */
+	uint8_t		state;
+	/** Bytes of payload received. */
+	uint8_t		pos;
+	/** CRC so far. */
+	uint16_t	crc;
+	/** Number of frames dropped because of a bad CRC or length. */
+	uint16_t	errors;
+} FRAME_DECODER;
+
+/** Function that sends one byte, i.e. uart_putchar. */
+typedef void (*FRAME_PUTCHAR)(const uint8_t c);
+
+/** Initialize decoder. */
+void
+frame_decoder_init(
+	FRAME_DECODER*	dec
+);
+
+/** Feed one byte to the decoder.
+ * \param[in,out]	dec		Decoder.
+ * \param[in]		c		Byte received.
+ * \return		true when a frame with a good CRC has been completed; it is in \c dec->frame
+ * 				until the next call.
+ */
+bool
+frame_decode(
+	FRAME_DECODER*	dec,
+	const uint8_t	c
+);
+
+/** Send a frame.
+ * \param[in]	put		Function to send a byte.
+ * \param[in]	address	Address.
+ * \param[in]	command	Command.
+ * \param[in]	payload	Payload.
+ * \param[in]	length	Length of the payload.
+ */
+void
+frame_send(
+	const FRAME_PUTCHAR	put,
+	const uint8_t		address,
+	const uint8_t		command,
+	const void*			payload,
+	const uint8_t		length
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* frame_h_ */
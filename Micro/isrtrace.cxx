@@ -0,0 +1,221 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/CBuffer.h>
+#include <Micro/shared.h>
+#include <Micro/uart.h>
+#include <Micro/isrtrace.h>
+
+#if !defined(ISRTRACE_CLOCK_DIV)
+#error ISRTRACE_CLOCK_DIV must be defined together with ISRTRACE_CLOCK.
+#endif
+
+#if !defined(ISRTRACE_BUFFER_SIZE)
+/** Number of slots in the ring, one is always unused. */
+#define	ISRTRACE_BUFFER_SIZE	16
+#endif
+
+/// Batch start marker.
+#define	BATCH_START		0xA6
+/// Statistics marker.
+#define	STATS_START		0xA7
+/// Size of a record on the wire.
+#define	RECORD_SIZE		5
+/// Size of statistics on the wire.
+#define	STATS_SIZE		18
+
+/*****************************************************************************/
+static CBuffer<ISRTRACE_RECORD, ISRTRACE_BUFFER_SIZE>	ring;
+/// Statistics, updated in interrupts.
+static ISRTRACE_STATS	stats[ISRTRACE_VECTORS];
+/// Guards stats; interrupts are not nested, thus one writer at a time.
+static SEQLOCK			stats_lock;
+/// Is tracing on?
+static bool				enabled = false;
+/// Vector being traced.
+static uint8_t			current_id = 0;
+/// Entry time of the vector being traced.
+static uint16_t			current_start = 0;
+/// Number of records lost.
+static uint16_t			dropped = 0;
+/// Next vector to be sent by isrtrace_send_stats.
+static uint8_t			next_stats = 0;
+
+/*****************************************************************************/
+void
+isrtrace_start(void)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	ISRTRACE_RECORD	record;
+	while (ring.Pop(record)) {
+	}
+	for (uint8_t i=0; i<ISRTRACE_VECTORS; ++i) {
+		stats[i].count		= 0;
+		stats[i].min		= 0xFFFF;
+		stats[i].max		= 0;
+		stats[i].total		= 0;
+		stats[i].latency	= 0;
+	}
+	dropped = 0;
+	next_stats = 0;
+	enabled = true;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+isrtrace_stop(void)
+{
+	enabled = false;
+}
+
+/*****************************************************************************/
+void
+isrtrace_enter(
+	const uint8_t	id,
+	const uint16_t	latency
+)
+{
+	current_start = ISRTRACE_CLOCK();
+	current_id = id;
+	if (enabled && id < ISRTRACE_VECTORS && latency > stats[id].latency) {
+		seqlock_write_begin(&stats_lock);
+		stats[id].latency = latency;
+		seqlock_write_end(&stats_lock);
+	}
+}
+
+/*****************************************************************************/
+void
+isrtrace_exit(void)
+{
+	const uint16_t	duration = ISRTRACE_CLOCK() - current_start;
+
+	if (!enabled) {
+		return;
+	}
+
+	if (current_id < ISRTRACE_VECTORS) {
+		ISRTRACE_STATS*	s = &stats[current_id];
+		seqlock_write_begin(&stats_lock);
+		++s->count;
+		s->total += duration;
+		if (duration < s->min) {
+			s->min = duration;
+		}
+		if (duration > s->max) {
+			s->max = duration;
+		}
+		seqlock_write_end(&stats_lock);
+	}
+
+	ISRTRACE_RECORD	record;
+	record.id = current_id;
+	record.start = current_start;
+	record.duration = duration;
+	if (!ring.Push(record)) {
+		++dropped;
+	}
+}
+
+/*****************************************************************************/
+static void
+send_u16(
+	const uint16_t	x
+)
+{
+	uart_putchar(x & 0xFF);
+	uart_putchar(x >> 8);
+}
+
+/*****************************************************************************/
+static void
+send_u32(
+	const uint32_t	x
+)
+{
+	send_u16(x & 0xFFFF);
+	send_u16(x >> 16);
+}
+
+/*****************************************************************************/
+uint8_t
+isrtrace_drain(
+	const uint8_t	max_records
+)
+{
+	const uint8_t	tx_free = uart_tx_free();
+	if (tx_free < 2 + RECORD_SIZE) {
+		return 0;
+	}
+
+	uint8_t	n = ring.Count();
+	if (n > max_records) {
+		n = max_records;
+	}
+	if (n > (tx_free - 2) / RECORD_SIZE) {
+		n = (tx_free - 2) / RECORD_SIZE;
+	}
+	if (n == 0) {
+		return 0;
+	}
+
+	uart_putchar(BATCH_START);
+	uart_putchar(n);
+	for (uint8_t i=0; i<n; ++i) {
+		const ISRTRACE_RECORD	record = ring.Pop();
+		uart_putchar(record.id);
+		send_u16(record.start);
+		send_u16(record.duration);
+	}
+	return n;
+}
+
+/*****************************************************************************/
+bool
+isrtrace_send_stats(void)
+{
+	while (next_stats < ISRTRACE_VECTORS) {
+		ISRTRACE_STATS	s;
+		isrtrace_get_stats(next_stats, &s);
+		if (s.count > 0) {
+			if (uart_tx_free() < STATS_SIZE) {
+				return false;
+			}
+			uart_putchar(STATS_START);
+			uart_putchar(next_stats);
+			send_u16(ISRTRACE_CLOCK_DIV);
+			send_u32(s.count);
+			send_u16(s.min);
+			send_u16(s.max);
+			send_u32(s.total);
+			send_u16(s.latency);
+		}
+		++next_stats;
+	}
+	next_stats = 0;
+	return true;
+}
+
+/*****************************************************************************/
+void
+isrtrace_get_stats(
+	const uint8_t	id,
+	ISRTRACE_STATS*	s
+)
+{
+	seqlock_read(&stats_lock, s, &stats[id], sizeof(*s));
+}
+
+/*****************************************************************************/
+uint16_t
+isrtrace_dropped(void)
+{
+	return dropped;
+}
@@ -0,0 +1,184 @@
+// vim: ts=4 shiftwidth=4
+#ifndef isrtrace_h_
+#define isrtrace_h_
+
+/** \file
+ * Opt-in interrupt tracing. When MICRO_ISR_TRACE is defined on the compiler's command line, every
+ * interrupt handler in Micro records its entry time, execution time and vector ID into a ring
+ * buffer and updates per-vector statistics; without it the trace macros expand to nothing.
+ * The macros can be used in application interrupts too, with IDs from ISRTRACE_USER on.
+ *
+ * Time is read by ISRTRACE_CLOCK(), by default timer_counts() of the timebase (timer.h), one
+ * clock is ISRTRACE_CLOCK_DIV CPU clocks (6.4 us at 10 MHz). For CPU clock resolution, run
+ * Timer1 free at F_CPU/1 (no acquisition) and define ISRTRACE_CLOCK()=TCNT1 and
+ * ISRTRACE_CLOCK_DIV=1.
+ *
+ * Latency, from the compare match to the handler, is known for timer vectors only and is
+ * measured in CPU clocks from the counter of the timer itself; resolution is its prescaler.
+ *
+ * Interrupt handlers must not be nested. Tracing costs about 100 CPU clocks per interrupt,
+ * which is included in the execution times.
+ *
+ * Trace batch format on the UART, all multi-byte fields little-endian:
+ * <ol>
+ *   <li>0xA6 - batch start.
+ *   <li>N - number of records in the batch.
+ *   <li>N records of 5 bytes: vector ID, entry time (2 bytes), execution time (2 bytes), in
+ *   trace clocks.
+ * </ol>
+ * Statistics format: 0xA7, vector ID, ISRTRACE_CLOCK_DIV (2 bytes), count (4 bytes),
+ * min (2 bytes), max (2 bytes), total (4 bytes) execution time in trace clocks,
+ * worst latency (2 bytes) in CPU clocks; 18 bytes.
+ *
+ * The decoder is host/isrtrace.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Build everything with -DMICRO_ISR_TRACE.
+ *   <li>Start the timebase by calling <b>timer_init</b>, setup UART by calling <b>uart_setup</b>.
+ *   <li>Call <b>isrtrace_start</b>, then <b>isrtrace_drain</b> from the main loop and
+ *   <b>isrtrace_send_stats</b> now and then.
+ * </ol>
+ * Tracing the UART interrupts while draining to the same UART generates one record per byte
+ * sent; leave them out by defining ISRTRACE_NO_UART.
+ *
+ * Ring size is 16 records by default; define ISRTRACE_BUFFER_SIZE on the compiler's command
+ * line to change it.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <Micro/timer.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(ISRTRACE_CLOCK)
+/** Trace clock, 16 bits. */
+#define	ISRTRACE_CLOCK()	timer_counts()
+/** CPU clocks per trace clock. */
+#define	ISRTRACE_CLOCK_DIV	TIMER_PRESCALER
+#endif
+
+/** Vector IDs. */
+enum {
+	ISRTRACE_TWI = 0,
+	ISRTRACE_USART_RX,
+	ISRTRACE_USART_UDRE,
+	ISRTRACE_USART_TX,
+	ISRTRACE_SPI_STC,
+	ISRTRACE_DAC_USART_TX,
+	ISRTRACE_TIMER0_COMPA,
+	ISRTRACE_TIMER1_COMPA,
+	ISRTRACE_TIMER2_COMPA,
+	ISRTRACE_EE_READY,
+	ISRTRACE_WDT,
+	ISRTRACE_PCINT_RXD,
+	/** First ID free for application interrupts. */
+	ISRTRACE_USER
+};
+
+#if !defined(ISRTRACE_VECTORS)
+/** Number of vector IDs with statistics. */
+#define	ISRTRACE_VECTORS	(ISRTRACE_USER + 2)
+#endif
+
+#if defined(MICRO_ISR_TRACE)
+/** Mark the start of an interrupt handler, first statement.
+ * \param[in]	id		Vector ID.
+ */
+#define	ISRTRACE_ENTER(id)						isrtrace_enter((id), 0)
+/** Mark the start of a timer interrupt handler, first statement.
+ * \param[in]	id		Vector ID.
+ * \param[in]	latency	CPU clocks since the interrupt condition, i.e. counter * prescaler.
+ */
+#define	ISRTRACE_ENTER_LATENCY(id, latency)		isrtrace_enter((id), (latency))
+/** Mark the end of an interrupt handler, last statement. */
+#define	ISRTRACE_EXIT()							isrtrace_exit()
+#else
+#define	ISRTRACE_ENTER(id)						do { } while (0)
+#define	ISRTRACE_ENTER_LATENCY(id, latency)		do { } while (0)
+#define	ISRTRACE_EXIT()							do { } while (0)
+#endif
+
+/** One interrupt. */
+typedef struct {
+	/** Vector ID. */
+	uint8_t		id;
+	/** Entry time, trace clocks. */
+	uint16_t	start;
+	/** Execution time, trace clocks. */
+	uint16_t	duration;
+} ISRTRACE_RECORD;
+
+/** Per-vector statistics. */
+typedef struct {
+	/** Number of interrupts. */
+	uint32_t	count;
+	/** Shortest execution time, trace clocks. */
+	uint16_t	min;
+	/** Longest execution time, trace clocks. */
+	uint16_t	max;
+	/** Sum of execution times, trace clocks. */
+	uint32_t	total;
+	/** Worst latency, CPU clocks. */
+	uint16_t	latency;
+} ISRTRACE_STATS;
+
+/** Clear the ring and statistics and start tracing. */
+void
+isrtrace_start(void);
+
+/** Stop tracing. Ring and statistics are kept. */
+void
+isrtrace_stop(void);
+
+/** Internal use only: called by ISRTRACE_ENTER. */
+void
+isrtrace_enter(
+	const uint8_t	id,
+	const uint16_t	latency
+);
+
+/** Internal use only: called by ISRTRACE_EXIT. */
+void
+isrtrace_exit(void);
+
+/** Send at most \c max_records trace records to the UART as one batch. Sends only what fits
+ * into the UART transmit buffer, thus never blocks.
+ * \param[in]	max_records	Maximum number of records to send.
+ * \return		Number of records sent.
+ */
+uint8_t
+isrtrace_drain(
+	const uint8_t	max_records
+);
+
+/** Send statistics of the vectors that have run to the UART, as much as fits into the UART
+ * transmit buffer; the next call continues from where this one stopped.
+ * \return		true when all vectors have been sent.
+ */
+bool
+isrtrace_send_stats(void);
+
+/** Get a consistent copy of the statistics of one vector.
+ * \param[in]	id		Vector ID, 0..ISRTRACE_VECTORS-1.
+ * \param[out]	stats	Statistics.
+ */
+void
+isrtrace_get_stats(
+	const uint8_t	id,
+	ISRTRACE_STATS*	stats
+);
+
+/** Number of records lost because the ring was full. */
+uint16_t
+isrtrace_dropped(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* isrtrace_h_ */
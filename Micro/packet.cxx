@@ -0,0 +1,102 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/CBuffer.h>
+#include <Micro/CPool.h>
+#include <Micro/uart.h>
+#include <Micro/packet.h>
+
+#if !defined(PACKET_QUEUE_SIZE)
+/** Number of slots in the receive queue, one is always unused. */
+#define	PACKET_QUEUE_SIZE	PACKET_POOL_SIZE
+#endif
+
+/*****************************************************************************/
+static CPool<PACKET, PACKET_POOL_SIZE>		pool;
+static CBuffer<PACKET*, PACKET_QUEUE_SIZE>	queue;
+/// Packets freed because the queue was full.
+static uint16_t		dropped = 0;
+
+/*****************************************************************************/
+PACKET*
+packet_alloc(void)
+{
+	PACKET*	packet = pool.Alloc();
+	if (packet) {
+		packet->length = 0;
+	}
+	return packet;
+}
+
+/*****************************************************************************/
+void
+packet_free(
+	PACKET*	packet
+)
+{
+	if (packet) {
+		pool.Free(packet);
+	}
+}
+
+/*****************************************************************************/
+bool
+packet_post(
+	PACKET*	packet
+)
+{
+	if (queue.Push(packet)) {
+		return true;
+	}
+	++dropped;
+	pool.Free(packet);
+	return false;
+}
+
+/*****************************************************************************/
+PACKET*
+packet_receive(void)
+{
+	PACKET*	packet;
+	return queue.Pop(packet) ? packet : 0;
+}
+
+/*****************************************************************************/
+#if defined(UART_WITH_BLOCKS)
+static void
+sent(
+	void*	arg
+)
+{
+	pool.Free(static_cast<PACKET*>(arg));
+}
+
+/*****************************************************************************/
+bool
+packet_send(
+	PACKET*	packet
+)
+{
+	return uart_send_block(packet->data, packet->length, sent, packet);
+}
+#endif
+
+/*****************************************************************************/
+void
+packet_get_stats(
+	PACKET_STATS*	stats
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	stats->available = pool.Available();
+	stats->low_water = pool.LowWater();
+	stats->exhausted = pool.Exhausted();
+	stats->dropped = dropped;
+	SREG = sreg;
+}
@@ -0,0 +1,111 @@
+// vim: ts=4 shiftwidth=4
+#ifndef packet_h_
+#define packet_h_
+
+/** \file
+ * Packet buffers from a fixed pool, passed by pointer between interrupts, the main loop and the
+ * UART transmitter without copying. Whoever holds the pointer owns the packet and must either
+ * pass it on or free it.
+ *
+ * A typical receive path: the UART read callback allocates a packet, fills it, and posts it to
+ * the receive queue with <b>packet_post</b>; the main loop takes it with <b>packet_receive</b>,
+ * processes it, and either frees it or sends it (i.e. as a reply, edited in place) with
+ * <b>packet_send</b>, which frees it when sent.
+ *
+ * Allocation and release take constant time and are safe from interrupts. RAM use is fixed:
+ * PACKET_POOL_SIZE packets (default 4) of PACKET_SIZE bytes (default 32) plus one length byte.
+ * Define them on the compiler's command line to change them.
+ *
+ * packet_send requires UART_WITH_BLOCKS, see uart.h.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(PACKET_SIZE)
+/** Maximum payload, bytes. */
+#define	PACKET_SIZE			32
+#endif
+
+#if !defined(PACKET_POOL_SIZE)
+/** Number of packets in the pool. */
+#define	PACKET_POOL_SIZE	4
+#endif
+
+/** Packet buffer. */
+typedef struct {
+	/** Number of bytes used in \c data. */
+	uint8_t		length;
+	/** Payload. */
+	uint8_t		data[PACKET_SIZE];
+} PACKET;
+
+/** Pool and queue statistics. */
+typedef struct {
+	/** Free packets now. */
+	uint8_t		available;
+	/** Fewest free packets seen. */
+	uint8_t		low_water;
+	/** Failed allocations. */
+	uint16_t	exhausted;
+	/** Packets freed because the receive queue was full. */
+	uint16_t	dropped;
+} PACKET_STATS;
+
+/** Allocate a packet, length 0. Safe to call from interrupts.
+ * \return		Packet, or NULL when the pool is exhausted.
+ */
+PACKET*
+packet_alloc(void);
+
+/** Return a packet to the pool. Safe to call from interrupts.
+ * \param[in]	packet	Packet, NULL is ignored.
+ */
+void
+packet_free(
+	PACKET*	packet
+);
+
+/** Post a packet to the receive queue, ownership passes to the queue. Call from one context
+ * only, i.e. a single interrupt. When the queue is full, the packet is freed.
+ * \param[in]	packet	Packet.
+ * \return		true when queued.
+ */
+bool
+packet_post(
+	PACKET*	packet
+);
+
+/** Take the oldest packet from the receive queue, ownership passes to the caller. Main loop only.
+ * \return		Packet, or NULL when the queue is empty.
+ */
+PACKET*
+packet_receive(void);
+
+/** Send packet on the UART without copying and free it when sent. Main loop only.
+ * \param[in]	packet	Packet.
+ * \return		true when queued; false when the UART block queue is full, the caller keeps
+ * 				the packet.
+ */
+bool
+packet_send(
+	PACKET*	packet
+);
+
+/** Get pool and queue statistics.
+ * \param[out]	stats	Statistics.
+ */
+void
+packet_get_stats(
+	PACKET_STATS*	stats
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* packet_h_ */
@@ -0,0 +1,388 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#include <Micro/DAC8560.h>
+#include <Micro/isrtrace.h>
+#include <Micro/timer.h>
+#include <Micro/twislave.h>
+#include <Micro/uart.h>
+#include <Micro/power.h>	// ourselves
+
+// Checked only when linked.
+extern bool	DAC8560_Busy(void) __attribute__ ((weak));
+extern bool	twislave_busy() __attribute__ ((weak));
+
+#if POWER_WDT_MAX > 9
+#error POWER_WDT_MAX must be 0..9.
+#endif
+
+/// Ticks per watchdog period at the shortest setting.
+#define	WDT_TICKS	((uint32_t)((POWER_WDT_US * 256.0) / TIMER_TICK_US_Q8 + 0.5))
+/// Timer0 clocks per millisecond.
+#define	COUNTS_PER_MS	(F_CPU / 1000 / TIMER_PRESCALER)
+
+#if defined(WDIE) && defined(WDTCSR)
+/** Internal use only: watchdog interrupt available? */
+#define	POWER_WITH_WDT
+#endif
+
+#if defined(UCSR0B)
+#define	UART_RX_ENABLED()	(UCSR0B & _BV(RXEN0))
+#else
+#define	UART_RX_ENABLED()	(UCSRB & _BV(RXEN))
+#endif
+
+// RXD is PD0 on all of them.
+#if !defined(POWER_NO_UART_WAKE)
+#if defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__) || defined(__AVR_ATmega324P__) || defined(__AVR_ATmega164P__)
+#define	RXD_PCMSK	PCMSK3
+#define	RXD_PCIE	PCIE3
+#define	RXD_PCIF	PCIF3
+#define	RXD_PCINT	PCINT24
+#define	RXD_VECT	PCINT3_vect
+#elif defined(PCMSK2)
+// ATmega48/88/168/328.
+#define	RXD_PCMSK	PCMSK2
+#define	RXD_PCIE	PCIE2
+#define	RXD_PCIF	PCIF2
+#define	RXD_PCINT	PCINT16
+#define	RXD_VECT	PCINT2_vect
+#endif
+#endif
+
+/*****************************************************************************/
+static POWER_STATS		stats;
+/// Timer0 clocks of stats.active, idle and down below a millisecond.
+static uint16_t			active_rem = 0;
+static uint16_t			idle_rem = 0;
+static uint16_t			down_rem = 0;
+/// Timer0 clocks at the last wake-up or power_sleep return.
+static uint16_t			last = 0;
+/// Timer0 clocks at the last power-down wake-up.
+static uint16_t			woken_at = 0;
+/// Waiting for power_response?
+static bool				response_pending = false;
+/// Within POWER_UART_AWAKE_MS of a wake-up on RXD or a byte received?
+static bool				uart_awake = false;
+/// Ticks at the start of the window.
+static uint32_t			uart_awake_at = 0;
+/// uart_rx_count at the last check.
+static uint8_t			rx_seen = 0;
+/// Wake-up sources, POWER_WAKE_*, set by the interrupts.
+static volatile uint8_t	woken_by = 0;
+
+/*****************************************************************************/
+#if defined(POWER_WITH_WDT)
+ISR(WDT_vect)
+{
+	ISRTRACE_ENTER(ISRTRACE_WDT);
+	woken_by |= POWER_WAKE_TIMER;
+	ISRTRACE_EXIT();
+}
+#endif
+
+/*****************************************************************************/
+#if defined(RXD_VECT)
+ISR(RXD_VECT)
+{
+	ISRTRACE_ENTER(ISRTRACE_PCINT_RXD);
+	// One-shot, the UART takes over.
+	RXD_PCMSK &= ~_BV(RXD_PCINT);
+	woken_by |= POWER_WAKE_UART;
+	ISRTRACE_EXIT();
+}
+#endif
+
+/*****************************************************************************/
+void
+power_init(void)
+{
+	power_reset_stats();
+	response_pending = false;
+	uart_awake = false;
+	rx_seen = uart_rx_count();
+	woken_by = 0;
+}
+
+/*****************************************************************************/
+void
+power_reset_stats(void)
+{
+	stats.active		= 0;
+	stats.idle			= 0;
+	stats.down			= 0;
+	stats.wakeups		= 0;
+	stats.early			= 0;
+	stats.latency_last	= 0;
+	stats.latency_max	= 0;
+	active_rem			= 0;
+	idle_rem			= 0;
+	down_rem			= 0;
+	last = timer_counts();
+}
+
+/*****************************************************************************/
+/** Add Timer0 clocks to a time in milliseconds, keeping the remainder. */
+static void
+add_counts(
+	uint32_t*		ms,
+	uint16_t*		rem,
+	const uint32_t	counts
+)
+{
+	const uint32_t	n = counts + *rem;
+	*ms += n / COUNTS_PER_MS;
+	*rem = n % COUNTS_PER_MS;
+}
+
+/*****************************************************************************/
+/** Is a request on the UART possibly under way? Interrupts are disabled. */
+static bool
+uart_awake_window(void)
+{
+	const uint32_t	now = timer_ticks();
+	const uint8_t	rx = uart_rx_count();
+	if (rx != rx_seen) {
+		rx_seen = rx;
+		uart_awake = true;
+		uart_awake_at = now;
+	}
+	if (uart_awake && now - uart_awake_at >= TIMER_MS(POWER_UART_AWAKE_MS)) {
+		uart_awake = false;
+	}
+	return uart_awake;
+}
+
+/*****************************************************************************/
+/** Can the clock be stopped? Interrupts are disabled. */
+static bool
+down_allowed(void)
+{
+	if (!uart_tx_idle()) {
+		return false;
+	}
+	if (twislave_busy && twislave_busy()) {
+		return false;
+	}
+	if (DAC8560_Busy && DAC8560_Busy()) {
+		return false;
+	}
+#if defined(TIMSK1)
+	if ((TIMSK1 & _BV(OCIE1A)) || (TIMSK2 & _BV(OCIE2A))) {
+#else
+	if (TIMSK & (_BV(OCIE1A) | _BV(OCIE2))) {
+#endif
+		return false;
+	}
+	if (UART_RX_ENABLED()) {
+#if defined(RXD_VECT)
+		// A byte being received, or more of a request to come.
+		if (!(PIND & _BV(PD0)) || uart_awake_window()) {
+			return false;
+		}
+#elif !defined(POWER_NO_UART_WAKE)
+		return false;
+#endif
+	}
+	return !power_down_callback || power_down_callback();
+}
+
+/*****************************************************************************/
+uint8_t
+power_sleep(void)
+{
+	cli();
+	const uint16_t	idle_ticks = timer_idle_ticks();
+	if (idle_ticks == 0) {
+		sei();
+		return POWER_AWAKE;
+	}
+	const uint16_t	now = timer_counts();
+	add_counts(&stats.active, &active_rem, (uint16_t)(now - last));
+
+	// Watchdog prescaler: the longest period that ends before the next timer.
+	bool	down = down_allowed();
+	uint8_t	p = POWER_WDT_MAX;
+#if defined(POWER_WITH_WDT)
+	while (p > 0 && (WDT_TICKS << p) > idle_ticks) {
+		--p;
+	}
+	if (WDT_TICKS > idle_ticks) {
+		down = false;
+	}
+#else
+	if (idle_ticks != 0xFFFF) {
+		down = false;
+	}
+#endif
+
+	if (!down) {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		// sei() takes effect after the next instruction, thus no wakeup is lost.
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		last = timer_counts();
+		add_counts(&stats.idle, &idle_rem, (uint16_t)(last - now));
+		return POWER_IDLE;
+	}
+
+	// Switch off for the sleep: ADC, unless converting. Writing 0 to ADIF keeps it.
+	const uint8_t	adcsra = ADCSRA;
+	if ((adcsra & _BV(ADEN)) && !(adcsra & _BV(ADSC))) {
+		ADCSRA = adcsra & ~(_BV(ADEN) | _BV(ADIF));
+	}
+	// Switch on for the sleep: pin change on RXD, watchdog interrupt.
+#if defined(RXD_VECT)
+	if (UART_RX_ENABLED()) {
+		PCIFR = _BV(RXD_PCIF);
+		RXD_PCMSK |= _BV(RXD_PCINT);
+		PCICR |= _BV(RXD_PCIE);
+	}
+#endif
+#if defined(POWER_WITH_WDT)
+	const uint8_t	wdtcsr = WDTCSR & (_BV(WDE) | _BV(WDIE) | _BV(WDP3) | _BV(WDP2) | _BV(WDP1) | _BV(WDP0));
+	const uint8_t	wdt_sleep = _BV(WDIE) | ((p & 8) ? _BV(WDP3) : 0) | (p & 7);
+	// WDE cannot be cleared while WDRF is set.
+	MCUSR &= ~_BV(WDRF);
+	wdt_reset();
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = wdt_sleep;
+#endif
+	woken_by = 0;
+
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	sleep_enable();
+#if defined(BODS)
+	sleep_bod_disable();
+#endif
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	// Restore.
+	cli();
+#if defined(POWER_WITH_WDT)
+	wdt_reset();
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = wdtcsr;
+#endif
+#if defined(RXD_VECT)
+	RXD_PCMSK &= ~_BV(RXD_PCINT);
+#endif
+	if ((adcsra & _BV(ADEN)) && !(adcsra & _BV(ADSC))) {
+		ADCSRA = (ADCSRA & ~_BV(ADIF)) | _BV(ADEN);
+	}
+	sei();
+
+	// Time asleep: the whole period when the watchdog woke us, half of it otherwise.
+	if (woken_by == 0) {
+		woken_by = POWER_WAKE_OTHER;
+	}
+	uint32_t	slept = WDT_TICKS << p;
+	if (!(woken_by & POWER_WAKE_TIMER)) {
+		slept /= 2;
+		++stats.early;
+	}
+	timer_advance(slept);
+	if (woken_by & POWER_WAKE_UART) {
+		// The wake-up byte is lost, the request follows.
+		uart_awake = true;
+		uart_awake_at = timer_ticks();
+	}
+	add_counts(&stats.down, &down_rem, slept * TIMER_COUNTS);
+	++stats.wakeups;
+
+	last = timer_counts();
+	woken_at = last;
+	response_pending = true;
+	return POWER_DOWN;
+}
+
+/*****************************************************************************/
+uint8_t
+power_woken_by(void)
+{
+	return woken_by;
+}
+
+/*****************************************************************************/
+void
+power_response(void)
+{
+	uart_awake = false;
+	if (response_pending) {
+		response_pending = false;
+		stats.latency_last = timer_counts() - woken_at;
+		if (stats.latency_last > stats.latency_max) {
+			stats.latency_max = stats.latency_last;
+		}
+	}
+}
+
+/*****************************************************************************/
+void
+power_get_stats(
+	POWER_STATS*	s
+)
+{
+	*s = stats;
+	// Time awake so far.
+	s->active += (active_rem + (uint32_t)(uint16_t)(timer_counts() - last)) / COUNTS_PER_MS;
+}
+
+/*****************************************************************************/
+uint32_t
+power_average_ua(
+	const POWER_STATS*	s
+)
+{
+	uint32_t	active = s->active;
+	uint32_t	idle = s->idle;
+	uint32_t	down = s->down;
+
+	// Scale down so that the products fit into 32 bits.
+	while ((active | idle | down) >= (1UL << 16)) {
+		active >>= 1;
+		idle >>= 1;
+		down >>= 1;
+	}
+	const uint32_t	total = active + idle + down;
+	if (total == 0) {
+		return 0;
+	}
+	return (active * POWER_ACTIVE_UA + idle * POWER_IDLE_UA + down * POWER_DOWN_UA) / total;
+}
+
+/*****************************************************************************/
+void
+power_report(void)
+{
+	POWER_STATS		s;
+	power_get_stats(&s);
+
+	// Scale down so that neither the sum nor the per mille overflows.
+	uint32_t		active = s.active;
+	uint32_t		idle = s.idle;
+	uint32_t		down = s.down;
+	while ((active | idle | down) >= (1UL << 20)) {
+		active >>= 1;
+		idle >>= 1;
+		down >>= 1;
+	}
+	const uint32_t	total = active + idle + down;
+	const uint32_t	startup_us = (uint32_t)(POWER_STARTUP_CLOCKS * 1000000.0 / F_CPU + 0.5);
+
+	println_u32(PSTR("Awake ms"), s.active);
+	println_u32(PSTR("Idle ms"), s.idle);
+	println_u32(PSTR("Down ms"), s.down);
+	println_u16(PSTR("Awake permille"), total > 0 ? active * 1000 / total : 0);
+	println_u16(PSTR("Wakeups"), s.wakeups);
+	println_u32(PSTR("Wake latency us"),
+		startup_us + (((uint32_t)s.latency_max * TIMER_COUNT_US_Q8) >> 8));
+	println_u32(PSTR("Current uA"), power_average_ua(&s));
+}
@@ -0,0 +1,211 @@
+// vim: ts=4 shiftwidth=4
+#ifndef power_h_
+#define power_h_
+
+/** \file
+ * Sleep with wake-up on events, for nodes polled over TWI or UART. <b>power_sleep</b>, called
+ * from the main loop, chooses the deepest safe sleep mode:
+ * <ol>
+ *   <li>Power-down, when the UART has sent everything (uart_tx_idle), no TWI transfer is in
+ *   progress (twislave_busy), the DAC is idle (DAC8560_Busy), Timer1 and Timer2 compare
+ *   interrupts are off (acquisition, waveform) and <b>power_down_callback</b>, if any, agrees.
+ *   The MCU wakes on a TWI address match, on the start bit of a byte on RXD via pin change
+ *   interrupt, or on the watchdog timer when the next software timer (timer.h) is due.
+ *   <li>Idle otherwise; any interrupt wakes the MCU, the timebase tick at the latest.
+ * </ol>
+ * Peripheral registers keep their contents in power-down; power_sleep switches the ADC off and
+ * the pin change and watchdog interrupts on only for the sleep, and restores them after it.
+ *
+ * Timekeeping: Timer0 stops in power-down. The watchdog period, 16 ms << p with p chosen up to
+ * POWER_WDT_MAX so that the period ends before the next software timer is due, is added to the
+ * timebase on wake-up (timer_advance); after a wake-up by TWI or UART half the period is added,
+ * the expected value. The watchdog oscillator is accurate to about 10%, timers may fire that
+ * much late; keep POWER_WDT_MAX small when the time of day matters. A watchdog in reset mode is
+ * switched to interrupt mode for the sleep and restored after it; the watchdog reset flag WDRF
+ * in MCUSR is cleared, read it at start.
+ *
+ * Wake-up latency is the oscillator start-up, POWER_STARTUP_CLOCKS as set by the CKSEL and SUT
+ * fuses (16K CK for a crystal, 1.6 ms at 10 MHz; 1K CK with a ceramic resonator), plus the time
+ * from the wake-up until the main loop has answered, which is measured: call
+ * <b>power_response</b> when the request has been served.
+ * <ol>
+ *   <li>TWI: the slave holds SCL low from the address match until the oscillator runs, thus the
+ *   master must allow clock stretching for the start-up time.
+ *   <li>UART: the bytes arriving during the start-up are lost. The host sends a wake-up byte and
+ *   waits longer than the start-up before the request, see the -w option of host/regtool. After
+ *   a wake-up on RXD, and after every byte received, power_sleep uses idle mode only for
+ *   POWER_UART_AWAKE_MS or until power_response is called, thus the request and the following
+ *   bytes of a frame are received. The -w wait must be shorter than POWER_UART_AWAKE_MS, and
+ *   the window longer than the gaps between bytes of a frame: a few frame times at the baud rate.
+ * </ol>
+ *
+ * Average current is estimated by <b>power_average_ua</b> from the time spent awake, in idle
+ * and in power-down, with the MCU currents POWER_ACTIVE_UA, POWER_IDLE_UA and POWER_DOWN_UA;
+ * the defaults are typical ATmega644 values at 10 MHz, 5 V, to be replaced by measured ones.
+ * The start-up counts as power-down time, the board (regulator, transceivers) is not included.
+ * For the lowest power-down current, switch off the analog comparator (ACSR = _BV(ACD)), unused
+ * modules (PRR) and the digital input buffers of analog pins (DIDR0) once at start.
+ *
+ * Example: a node polled over TWI once a second, awake 2 ms per poll: 6000 uA * 0.2% +
+ * 10 uA * 99.8% = 22 uA on average, against 1500 uA sleeping in idle mode only.
+ *
+ * The module defines the watchdog interrupt and, unless POWER_NO_UART_WAKE is defined, the pin
+ * change interrupt of RXD (PCINT3 on ATmega644, PCINT2 on ATmega88); these must not be used by
+ * the application. Devices without a watchdog interrupt (ATmega8, ATmega16, etc.) go to
+ * power-down only when no software timer is armed; devices without pin change interrupts only
+ * when the UART receiver is off.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Start the timebase by calling <b>timer_init</b>, setup UART and TWI, then call
+ *   <b>power_init</b>.
+ *   <li>In the main loop: serve requests, calling <b>power_response</b> after each reply, run
+ *   <b>timer_poll</b> and call <b>power_sleep</b> last.
+ *   <li>Call <b>power_report</b> or <b>power_get_stats</b> now and then.
+ * </ol>
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(POWER_WDT_MAX)
+/** Longest watchdog period, 16 ms << POWER_WDT_MAX, 0..9 (9 is 8 s). Default 1 s. */
+#define	POWER_WDT_MAX			6
+#endif
+
+#if !defined(POWER_WDT_US)
+/** Watchdog period at the shortest setting, microseconds; nominal 2048 clocks at 128 kHz. */
+#define	POWER_WDT_US			16000
+#endif
+
+#if !defined(POWER_STARTUP_CLOCKS)
+/** Oscillator start-up time after power-down, CPU clocks, as set by the fuses. */
+#define	POWER_STARTUP_CLOCKS	16384
+#endif
+
+#if !defined(POWER_UART_AWAKE_MS)
+/** After a wake-up on RXD or a byte received, milliseconds without power-down. */
+#define	POWER_UART_AWAKE_MS		100
+#endif
+
+#if !defined(POWER_ACTIVE_UA)
+/** MCU current when awake, microamperes. */
+#define	POWER_ACTIVE_UA			6000
+#endif
+
+#if !defined(POWER_IDLE_UA)
+/** MCU current in idle mode, microamperes. */
+#define	POWER_IDLE_UA			1500
+#endif
+
+#if !defined(POWER_DOWN_UA)
+/** MCU current in power-down mode with the watchdog running, microamperes. */
+#define	POWER_DOWN_UA			10
+#endif
+
+/** Sleep modes, returned by power_sleep. */
+enum {
+	/** Not slept, there was work to do. */
+	POWER_AWAKE = 0,
+	/** Idle mode. */
+	POWER_IDLE,
+	/** Power-down mode. */
+	POWER_DOWN
+};
+
+/** Wake-up sources, returned by power_woken_by. */
+/** Watchdog timer, i.e. a software timer is due. */
+#define	POWER_WAKE_TIMER		0x01
+/** Start bit on RXD. */
+#define	POWER_WAKE_UART			0x02
+/** Other interrupt: TWI address match, or application interrupts. */
+#define	POWER_WAKE_OTHER		0x04
+
+/** Statistics since power_init or power_reset_stats. Times awake, in idle and in power-down are
+ * milliseconds, rounded down; each wraps after 2^32 ms, 49.7 days, call power_reset_stats before.
+ * Latencies are Timer0 clocks, TIMER_PRESCALER CPU clocks each.
+ */
+typedef struct {
+	/** Time awake. */
+	uint32_t	active;
+	/** Time in idle mode. */
+	uint32_t	idle;
+	/** Time in power-down mode, from the watchdog periods. */
+	uint32_t	down;
+	/** Number of power-down sleeps. */
+	uint16_t	wakeups;
+	/** Number of them ended by TWI or UART, their time is estimated. */
+	uint16_t	early;
+	/** Time from the last wake-up to power_response, without the start-up. */
+	uint16_t	latency_last;
+	/** Longest time from a wake-up to power_response, without the start-up. */
+	uint16_t	latency_max;
+} POWER_STATS;
+
+/** Initialize and reset statistics. The timebase must be running. */
+void
+power_init(void);
+
+/** Sleep in the deepest safe mode until an interrupt. Returns at once when timer_poll has ticks
+ * to process. Main loop only.
+ * \return		POWER_AWAKE, POWER_IDLE or POWER_DOWN.
+ */
+uint8_t
+power_sleep(void);
+
+/** Wake-up sources of the last power-down, POWER_WAKE_* flags. */
+uint8_t
+power_woken_by(void);
+
+/** Mark that the request which woke the MCU has been served, for the latency statistics, and
+ * end the POWER_UART_AWAKE_MS window. Only the first call after a power-down counts for the
+ * latency.
+ */
+void
+power_response(void);
+
+/** Get statistics.
+ * \param[out]	stats	Statistics.
+ */
+void
+power_get_stats(
+	POWER_STATS*	stats
+);
+
+/** Reset statistics. */
+void
+power_reset_stats(void);
+
+/** Estimate the average MCU current.
+ * \param[in]	stats	Statistics.
+ * \return		Microamperes, 0 when no time has been recorded.
+ */
+uint32_t
+power_average_ua(
+	const POWER_STATS*	stats
+);
+
+/** Print times awake, in idle and in power-down in milliseconds, the share of time awake in
+ * per mille, wake-ups, the longest wake-up latency in microseconds including the start-up,
+ * and the average current in microamperes on the UART, one line each.
+ */
+void
+power_report(void);
+
+/** Called by power_sleep with interrupts disabled. Returning false keeps the MCU in idle mode,
+ * i.e. while peripherals not known to this module are working.
+ *
+ * Implemented by user code, optionally.
+ */
+extern bool
+power_down_callback(void) __attribute__ ((weak));
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* power_h_ */
@@ -0,0 +1,250 @@
+// vim: ts=4 shiftwidth=4
+#ifndef shared_h_
+#define shared_h_
+
+/** \file
+ * Sharing multi-byte data between interrupts and the main loop without tearing. On an 8-bit
+ * core, reading or writing anything wider than a byte takes several instructions and an
+ * interrupt can come in between; single bytes need none of this.
+ * <ol>
+ *   <li>Atomic accessors, <b>shared_load16</b> etc.: interrupts are disabled for the loads or
+ *   stores only, 4 to 8 CPU clocks more than the access itself.
+ *   <li>Sequence lock, SEQLOCK: written by an interrupt, read by the main loop with interrupts
+ *   enabled. The writer increments the sequence before and after the update; the reader copies
+ *   the data and retries when the sequence was odd or has changed.
+ *   <li>Double buffer, DOUBLEBUF: written by the main loop, read by an interrupt. The writer fills
+ *   the back buffer and publishes it by a single byte store; the interrupt reads the front buffer.
+ *   The interrupt may publish instead, at a point of its choosing, when the writer has handed the
+ *   back buffer over and leaves it alone until then; see waveform.c.
+ * </ol>
+ * The writer of a sequence lock must not be interrupted by its reader, otherwise the reader spins
+ * forever; likewise a double buffer must be read only by an interrupt, which cannot be
+ * interrupted by the writer. A sequence lock may have one writer at a time, i.e. one interrupt.
+ *
+ * Time with interrupts disabled shows in the latency of the timer vectors, see isrtrace.h.
+ *
+ * The worst-case interrupt-disable time before and after adopting these in the drivers has NOT
+ * been measured; no target was at hand. The windows removed, estimated by instruction count:
+ * timer_micros and timer_counts about 15 CPU clocks each, timer_ticks about 6, each get_stats
+ * copy (acquisition, controlloop, isrtrace) about 60. These are small next to the LTC2485 read
+ * in the acquisition interrupt, about 0.5 ms. To measure, set a spare pin before each cli() and
+ * clear it after the matching SREG restore, and compare the longest high time on a scope
+ * before and after. The TIMER0_COMPA latency from isrtrace resolves only TIMER_PRESCALER clocks.
+ *
+ * Usage:
+ * \code
+ * static SEQLOCK	lock;
+ * static STATS		stats;					// Updated in the interrupt.
+ *
+ * ISR(...) {
+ * 	seqlock_write_begin(&lock);
+ * 	++stats.count;
+ * 	seqlock_write_end(&lock);
+ * }
+ *
+ * void get_stats(STATS* s) {
+ * 	seqlock_read(&lock, s, &stats, sizeof(*s));
+ * }
+ * \endcode
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Compiler barrier: memory accesses are not moved across it. */
+#define	SHARED_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
+/*****************************************************************************/
+/** Load a 16-bit value shared with interrupts. */
+static inline uint16_t
+shared_load16(
+	const volatile uint16_t*	p
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	const uint16_t	r = *p;
+	SREG = sreg;
+	return r;
+}
+
+/** Load a 32-bit value shared with interrupts. */
+static inline uint32_t
+shared_load32(
+	const volatile uint32_t*	p
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	const uint32_t	r = *p;
+	SREG = sreg;
+	return r;
+}
+
+/** Store a 16-bit value shared with interrupts. */
+static inline void
+shared_store16(
+	volatile uint16_t*	p,
+	const uint16_t		x
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	*p = x;
+	SREG = sreg;
+}
+
+/** Store a 32-bit value shared with interrupts. */
+static inline void
+shared_store32(
+	volatile uint32_t*	p,
+	const uint32_t		x
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	*p = x;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+/** Sequence lock. Zero-initialized, i.e. static, or by seqlock_init. */
+typedef struct {
+	/** Odd while an update is in progress. */
+	volatile uint8_t	sequence;
+} SEQLOCK;
+
+/** Initialize. */
+static inline void
+seqlock_init(
+	SEQLOCK*	lock
+)
+{
+	lock->sequence = 0;
+}
+
+/** Writer: start of an update. */
+static inline void
+seqlock_write_begin(
+	SEQLOCK*	lock
+)
+{
+	++lock->sequence;
+	SHARED_BARRIER();
+}
+
+/** Writer: end of an update. */
+static inline void
+seqlock_write_end(
+	SEQLOCK*	lock
+)
+{
+	SHARED_BARRIER();
+	++lock->sequence;
+}
+
+/** Reader: start of a copy.
+ * \return		Sequence, to be given to seqlock_read_retry.
+ */
+static inline uint8_t
+seqlock_read_begin(
+	const SEQLOCK*	lock
+)
+{
+	uint8_t	s;
+	while ((s = lock->sequence) & 1) {
+	}
+	SHARED_BARRIER();
+	return s;
+}
+
+/** Reader: end of a copy.
+ * \param[in]	s	Sequence returned by seqlock_read_begin.
+ * \return		true when the data changed during the copy, which must be retried.
+ */
+static inline bool
+seqlock_read_retry(
+	const SEQLOCK*	lock,
+	const uint8_t	s
+)
+{
+	SHARED_BARRIER();
+	return lock->sequence != s;
+}
+
+/** Reader: consistent copy of \c size bytes. */
+static inline void
+seqlock_read(
+	const SEQLOCK*	lock,
+	void*			dst,
+	const void*		src,
+	const uint8_t	size
+)
+{
+	uint8_t	s;
+	do {
+		s = seqlock_read_begin(lock);
+		memcpy(dst, src, size);
+	} while (seqlock_read_retry(lock, s));
+}
+
+/*****************************************************************************/
+/** Double buffer index. The two buffers belong to the user. Zero-initialized, i.e. static, or
+ * by doublebuf_init. */
+typedef struct {
+	/** Buffer read by the interrupt, 0 or 1. */
+	volatile uint8_t	front;
+} DOUBLEBUF;
+
+/** Initialize: buffer 0 is the front one. */
+static inline void
+doublebuf_init(
+	DOUBLEBUF*	b
+)
+{
+	b->front = 0;
+}
+
+/** Reader, in the interrupt: buffer to read. */
+static inline uint8_t
+doublebuf_front(
+	const DOUBLEBUF*	b
+)
+{
+	return b->front;
+}
+
+/** Writer: buffer to fill. */
+static inline uint8_t
+doublebuf_back(
+	const DOUBLEBUF*	b
+)
+{
+	return b->front ^ 1;
+}
+
+/** Make the back buffer the front buffer. Called by the writer, or by the interrupt for a
+ * buffer handed over to it. The new back buffer, the old front, may be filled right away: the
+ * interrupt does not keep reading it once it has returned.
+ */
+static inline void
+doublebuf_publish(
+	DOUBLEBUF*	b
+)
+{
+	SHARED_BARRIER();
+	b->front = b->front ^ 1;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* shared_h_ */
@@ -0,0 +1,129 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include <Micro/uart.h>
+#include <Micro/stackmon.h>	// ourselves
+
+/// End of static data, set by the linker.
+extern uint8_t		_end;
+/// Start of static data, set by the linker.
+extern uint8_t		__data_start;
+/// Top of the stack, set by the linker.
+extern uint8_t		__stack;
+
+/// Lowest address known to be used by the stack.
+static uint8_t*		low = &__stack;
+
+/*****************************************************************************/
+/** Paint free RAM. Runs in .init1, before the stack pointer and r1 are set up, thus no C. */
+void
+stackmon_paint(void) __attribute__ ((naked, used, section (".init1")));
+
+void
+stackmon_paint(void)
+{
+	__asm__ __volatile__ (
+		"	ldi r30, lo8(_end)\n"
+		"	ldi r31, hi8(_end)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(__stack)\n"
+		"	rjmp 2f\n"
+		"1:	st Z+, r24\n"
+		"2:	cpi r30, lo8(__stack)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		"	breq 1b\n"
+		:
+		: "M" (STACKMON_CANARY)
+	);
+}
+
+/*****************************************************************************/
+uint16_t
+stackmon_static(void)
+{
+	return &_end - &__data_start;
+}
+
+/*****************************************************************************/
+uint16_t
+stackmon_unused(void)
+{
+	uint8_t*	p = &_end;
+	while (p < low && *p == STACKMON_CANARY) {
+		++p;
+	}
+	low = p;
+	return p - &_end;
+}
+
+/*****************************************************************************/
+uint16_t
+stackmon_max_used(void)
+{
+	stackmon_unused();
+	return &__stack - low + 1;
+}
+
+/*****************************************************************************/
+uint16_t
+stackmon_headroom(void)
+{
+	return (uint8_t*)SP - &_end;
+}
+
+/*****************************************************************************/
+uint16_t
+stackmon_check(void)
+{
+	const uint16_t	unused = stackmon_unused();
+	if (unused < STACKMON_THRESHOLD) {
+		if (stackmon_trap_callback) {
+			stackmon_trap_callback(unused);
+		} else {
+			cli();
+			for (;;) {
+			}
+		}
+	}
+	return unused;
+}
+
+/*****************************************************************************/
+void
+stackmon_report(void)
+{
+	println_u16(PSTR("Static RAM"), stackmon_static());
+	println_u16(PSTR("Stack max"), stackmon_max_used());
+	println_u16(PSTR("Stack unused"), stackmon_unused());
+	println_u16(PSTR("Headroom"), stackmon_headroom());
+}
+
+/*****************************************************************************/
+uint8_t
+stackmon_register_read(
+	const uint8_t	register_no
+)
+{
+	uint16_t	x;
+	switch (register_no / 2) {
+	case STACKMON_REG_STATIC / 2:
+		x = stackmon_static();
+		break;
+	case STACKMON_REG_MAX_USED / 2:
+		x = stackmon_max_used();
+		break;
+	case STACKMON_REG_UNUSED / 2:
+		x = stackmon_unused();
+		break;
+	case STACKMON_REG_HEADROOM / 2:
+		x = stackmon_headroom();
+		break;
+	default:
+		x = 0;
+		break;
+	}
+	return (register_no & 1) ? (x >> 8) : (x & 0xFF);
+}
@@ -0,0 +1,99 @@
+// vim: ts=4 shiftwidth=4
+#ifndef stackmon_h_
+#define stackmon_h_
+
+/** \file
+ * Stack usage monitor. At reset, before the C runtime starts, all RAM between the end of static
+ * data (_end) and the top of the stack is painted with STACKMON_CANARY. The stack grows down
+ * into the painted area; the painted bytes that remain give the high-water mark.
+ *
+ * RAM layout: .data and .bss from the start of RAM up to _end, then free RAM, then the stack
+ * growing down from RAMEND. The heap, when malloc is used, starts at _end and is counted as
+ * stack usage.
+ *
+ * Linking stackmon.o is enough for painting. The values are reported by <b>stackmon_report</b>
+ * on the UART or through twislave registers, see <b>stackmon_register_read</b>.
+ *
+ * Call <b>stackmon_check</b> periodically, i.e. from a timer; when fewer than STACKMON_THRESHOLD
+ * (default 32) bytes have never been used, <b>stackmon_trap_callback</b> is called. Without the
+ * callback the MCU stops with interrupts disabled, so that the watchdog, if enabled, resets it.
+ * The check scans the free RAM not yet known to be used, about 4 CPU clocks per byte.
+ *
+ * Static RAM per module is reported by "make ramreport", see the Makefile.
+ */
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Paint byte. */
+#define	STACKMON_CANARY			0xC5
+
+#if !defined(STACKMON_THRESHOLD)
+/** Minimum number of never used bytes before stackmon_check calls the trap. */
+#define	STACKMON_THRESHOLD		32
+#endif
+
+/** Read only: static RAM, .data + .bss, 2 bytes. */
+#define	STACKMON_REG_STATIC		0
+/** Read only: largest stack depth seen, 2 bytes. */
+#define	STACKMON_REG_MAX_USED	2
+/** Read only: bytes never used, 2 bytes. */
+#define	STACKMON_REG_UNUSED		4
+/** Read only: bytes free below the current stack pointer, 2 bytes. */
+#define	STACKMON_REG_HEADROOM	6
+/** Number of registers. */
+#define	STACKMON_REGISTERS		8
+
+/** Size of static data, .data + .bss. */
+uint16_t
+stackmon_static(void);
+
+/** Largest stack depth seen so far, bytes. */
+uint16_t
+stackmon_max_used(void);
+
+/** Number of painted bytes never used by the stack, the headroom left at the high-water mark. */
+uint16_t
+stackmon_unused(void);
+
+/** Number of bytes between the end of static data and the current stack pointer. */
+uint16_t
+stackmon_headroom(void);
+
+/** Update the high-water mark and call stackmon_trap_callback when below STACKMON_THRESHOLD.
+ * \return		Number of bytes never used.
+ */
+uint16_t
+stackmon_check(void);
+
+/** Print static RAM, stack maximum, unused and headroom on the UART, one line each. */
+void
+stackmon_report(void);
+
+/** Read monitor register, to be called from twislave_read_callback.
+ * \param[in]	register_no	Register number, 0..STACKMON_REGISTERS-1.
+ * \return		Register contents, 0 for unknown registers.
+ */
+uint8_t
+stackmon_register_read(
+	const uint8_t	register_no
+);
+
+/** Called by stackmon_check when fewer than STACKMON_THRESHOLD bytes have never been used.
+ *
+ * Implemented by user code, optionally.
+ * \param[in]	unused	Number of bytes never used.
+ */
+extern void
+stackmon_trap_callback(
+	const uint16_t	unused
+) __attribute__ ((weak));
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* stackmon_h_ */
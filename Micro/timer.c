@@ -0,0 +1,341 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/isrtrace.h>
+#include <Micro/shared.h>
+#include <Micro/timer.h>	// ourselves
+
+#if !defined(TIMSK0)
+#error timer requires Timer0 with CTC mode (ATmega88, ATmega644, etc).
+#endif
+
+#if TIMER_COUNTS > 256
+#error TIMER_TICK_HZ too low for F_CPU.
+#endif
+
+/// Slots per wheel level.
+#define	SLOTS	(1 << TIMER_WHEEL_BITS)
+/// Slot index mask.
+#define	MASK	(SLOTS - 1)
+
+/// Ticks since timer_init.
+static volatile uint32_t	ticks = 0;
+/// Microseconds at the last tick.
+static volatile uint32_t	us_base = 0;
+/// Fractional microseconds at the last tick, 1/256 us.
+static uint8_t				us_frac = 0;
+/// Timer0 clocks at the last tick.
+static volatile uint16_t	counts_base = 0;
+/// Guards ticks, us_base and counts_base, written by the interrupt.
+static SEQLOCK				clock_lock;
+
+/// Timers expiring within SLOTS ticks, by tick.
+static TIMER*				level0[SLOTS];
+/// Timers expiring within SLOTS*SLOTS ticks, by SLOTS ticks.
+static TIMER*				level1[SLOTS];
+/// Next tick to be processed by timer_poll.
+static uint32_t				wheel_time = 0;
+/// Longest tick processing time, microseconds.
+static uint16_t				poll_max = 0;
+
+/*****************************************************************************/
+ISR(TIMER0_COMPA_vect)
+{
+	// First, so that timer_counts is consistent for the trace; the trace must not be inside the
+	// update, timer_counts would spin.
+	seqlock_write_begin(&clock_lock);
+	counts_base += TIMER_COUNTS;
+	seqlock_write_end(&clock_lock);
+	ISRTRACE_ENTER_LATENCY(ISRTRACE_TIMER0_COMPA, TCNT0 * TIMER_PRESCALER);
+	const uint16_t	frac = us_frac + (uint8_t)TIMER_TICK_US_Q8;
+	seqlock_write_begin(&clock_lock);
+	++ticks;
+	us_base += TIMER_TICK_US + (frac >> 8);
+	seqlock_write_end(&clock_lock);
+	us_frac = (uint8_t)frac;
+	ISRTRACE_EXIT();
+}
+
+/*****************************************************************************/
+void
+timer_init(void)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+
+	ticks = 0;
+	us_base = 0;
+	us_frac = 0;
+	counts_base = 0;
+	seqlock_init(&clock_lock);
+	wheel_time = 0;
+	poll_max = 0;
+	for (uint8_t i=0; i<SLOTS; ++i) {
+		level0[i] = 0;
+		level1[i] = 0;
+	}
+
+	// CTC mode with OCR0A as TOP.
+	TCCR0A = (1<<WGM01);
+	TCCR0B = 0x00;
+	TCNT0 = 0;
+	OCR0A = TIMER_COUNTS - 1;
+	TIFR0 = (1<<OCF0A);
+	TIMSK0 |= (1<<OCIE0A);
+	TCCR0B = TIMER_PRESCALER == 64
+		? (1<<CS01) | (1<<CS00)
+		: (1<<CS02);
+
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+uint32_t
+timer_ticks(void)
+{
+	uint8_t		s;
+	uint32_t	r;
+	do {
+		s = seqlock_read_begin(&clock_lock);
+		r = ticks;
+	} while (seqlock_read_retry(&clock_lock, s));
+	return r;
+}
+
+/*****************************************************************************/
+uint32_t
+timer_micros(void)
+{
+	// Interrupts stay enabled; a tick during the reads is retried. Within an interrupt, or with
+	// interrupts disabled, the tick is pending instead.
+	uint8_t			s;
+	uint32_t		base;
+	uint8_t			count;
+	do {
+		s = seqlock_read_begin(&clock_lock);
+		base = us_base;
+		count = TCNT0;
+		if (TIFR0 & (1<<OCF0A)) {
+			// Tick pending, the counter has been or is about to be reset.
+			count = TCNT0;
+			base += TIMER_TICK_US;
+		}
+	} while (seqlock_read_retry(&clock_lock, s));
+	return base + (((uint32_t)count * TIMER_COUNT_US_Q8) >> 8);
+}
+
+/*****************************************************************************/
+uint16_t
+timer_counts(void)
+{
+	uint8_t			s;
+	uint16_t		base;
+	uint8_t			count;
+	do {
+		s = seqlock_read_begin(&clock_lock);
+		base = counts_base;
+		count = TCNT0;
+		if (TIFR0 & (1<<OCF0A)) {
+			count = TCNT0;
+			base += TIMER_COUNTS;
+		}
+	} while (seqlock_read_retry(&clock_lock, s));
+	return base + count;
+}
+
+/*****************************************************************************/
+void
+timer_advance(
+	const uint32_t	n
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	const uint32_t	frac = us_frac + n * (uint8_t)TIMER_TICK_US_Q8;
+	seqlock_write_begin(&clock_lock);
+	counts_base += (uint16_t)(n * TIMER_COUNTS);
+	ticks += n;
+	us_base += n * TIMER_TICK_US + (frac >> 8);
+	seqlock_write_end(&clock_lock);
+	us_frac = (uint8_t)frac;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+static void
+link(
+	TIMER*	timer
+)
+{
+	TIMER**			slot;
+	const int32_t	delta = (int32_t)(timer->expires - wheel_time);
+
+	if (delta < SLOTS) {
+		slot = &level0[timer->expires & MASK];
+	} else if (delta < (int32_t)SLOTS * SLOTS) {
+		slot = &level1[(timer->expires >> TIMER_WHEEL_BITS) & MASK];
+	} else {
+		// Farthest level 1 slot, re-sorted when it comes around.
+		slot = &level1[((wheel_time >> TIMER_WHEEL_BITS) + MASK) & MASK];
+	}
+
+	timer->next = *slot;
+	if (timer->next) {
+		timer->next->pprev = &timer->next;
+	}
+	*slot = timer;
+	timer->pprev = slot;
+}
+
+/*****************************************************************************/
+static void
+unlink(
+	TIMER*	timer
+)
+{
+	*timer->pprev = timer->next;
+	if (timer->next) {
+		timer->next->pprev = timer->pprev;
+	}
+	timer->next = 0;
+	timer->pprev = 0;
+}
+
+/*****************************************************************************/
+void
+timer_setup(
+	TIMER*					timer,
+	const TIMER_CALLBACK	callback,
+	void*					arg
+)
+{
+	timer->next		= 0;
+	timer->pprev	= 0;
+	timer->expires	= 0;
+	timer->period	= 0;
+	timer->callback	= callback;
+	timer->arg		= arg;
+}
+
+/*****************************************************************************/
+void
+timer_arm(
+	TIMER*			timer,
+	const uint32_t	delay,
+	const uint32_t	period
+)
+{
+	if (timer->pprev) {
+		unlink(timer);
+	}
+	timer->expires = timer_ticks() + (delay > 0 ? delay : 1);
+	timer->period = period;
+	link(timer);
+}
+
+/*****************************************************************************/
+void
+timer_cancel(
+	TIMER*	timer
+)
+{
+	if (timer->pprev) {
+		unlink(timer);
+	}
+}
+
+/*****************************************************************************/
+bool
+timer_armed(
+	const TIMER*	timer
+)
+{
+	return timer->pprev != 0;
+}
+
+/*****************************************************************************/
+uint16_t
+timer_poll(void)
+{
+	const uint32_t	now = timer_ticks();
+	uint16_t		n = 0;
+
+	while ((int32_t)(now - wheel_time) >= 0) {
+		const uint32_t	start = timer_micros();
+		const uint8_t	index = wheel_time & MASK;
+
+		if (index == 0) {
+			// Cascade: move level 1 slot down.
+			TIMER**	slot = &level1[(wheel_time >> TIMER_WHEEL_BITS) & MASK];
+			TIMER*	timer = *slot;
+			*slot = 0;
+			while (timer) {
+				TIMER*	next = timer->next;
+				link(timer);
+				timer = next;
+			}
+		}
+
+		// Expired timers.
+		while (level0[index]) {
+			TIMER*	timer = level0[index];
+			unlink(timer);
+			if (timer->period) {
+				timer->expires += timer->period;
+				link(timer);
+			}
+			timer->callback(timer->arg);
+		}
+
+		++wheel_time;
+		++n;
+
+		const uint32_t	elapsed = timer_micros() - start;
+		if (elapsed > poll_max) {
+			poll_max = elapsed > 0xFFFF ? 0xFFFF : (uint16_t)elapsed;
+		}
+	}
+	return n;
+}
+
+/*****************************************************************************/
+bool
+timer_pending(void)
+{
+	return (int32_t)(timer_ticks() - wheel_time) >= 0;
+}
+
+/*****************************************************************************/
+uint16_t
+timer_idle_ticks(void)
+{
+	const uint32_t	now = timer_ticks();
+	if ((int32_t)(now - wheel_time) >= 0) {
+		return 0;
+	}
+
+	// Level 0: exact.
+	for (uint8_t i=0; i<SLOTS; ++i) {
+		if (level0[(wheel_time + i) & MASK]) {
+			return wheel_time + i - now;
+		}
+	}
+
+	// Level 1: the cascade of the slot, i.e. the earliest possible expiry.
+	const uint32_t	base = (wheel_time + MASK) & ~(uint32_t)MASK;
+	for (uint8_t i=0; i<SLOTS; ++i) {
+		if (level1[((base >> TIMER_WHEEL_BITS) + i) & MASK]) {
+			const uint32_t	r = base + ((uint32_t)i << TIMER_WHEEL_BITS) - now;
+			return r > 0xFFFF ? 0xFFFF : (uint16_t)r;
+		}
+	}
+	return 0xFFFF;
+}
+
+/*****************************************************************************/
+uint16_t
+timer_poll_max(void)
+{
+	return poll_max;
+}
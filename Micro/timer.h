@@ -0,0 +1,190 @@
+// vim: ts=4 shiftwidth=4
+#ifndef timer_h_
+#define timer_h_
+
+/** \file
+ * Monotonic timebase and software timers.
+ *
+ * Timebase: Timer0 runs in CTC mode at F_CPU/64 (F_CPU/256 above 16 MHz with the default tick)
+ * and interrupts once per tick, TIMER_TICK_HZ (default 1000) ticks per second. The tick count is
+ * 32 bits; microsecond time combines the tick count with the Timer0 counter, resolution is one
+ * Timer0 count (6.4 us at 10 MHz). The tick period is rounded to whole Timer0 counts,
+ * TIMER_TICK_US gives the actual period. Reading the time does not disable interrupts, the
+ * interrupt updates it under a sequence lock (shared.h).
+ *
+ * Software timers: a hierarchical timer wheel of two levels with 2^TIMER_WHEEL_BITS slots each
+ * (default 16). Level 0 holds timers expiring within 16 ticks, level 1 within 256 ticks, later
+ * timers are re-sorted when their level 1 slot comes around. Arming and cancelling are O(1);
+ * each tick costs the expired timers plus, once every 16 ticks, the timers of one level 1 slot.
+ * Callbacks run from <b>timer_poll</b> in the main loop, not in the interrupt.
+ *
+ * Timers are allocated by the user and must not be modified while armed. Timer functions other
+ * than timer_ticks and timer_micros must not be called from interrupts.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Start the timebase by calling <b>timer_init</b> and enable interrupts.
+ *   <li>Setup timers by calling <b>timer_setup</b>, arm them by calling <b>timer_arm</b>.
+ *   <li>Call <b>timer_poll</b> from the main loop.
+ * </ol>
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(TIMER_TICK_HZ)
+/** Ticks per second. */
+#define	TIMER_TICK_HZ	1000
+#endif
+
+#if !defined(TIMER_WHEEL_BITS)
+/** Number of slots per wheel level is 2^TIMER_WHEEL_BITS. */
+#define	TIMER_WHEEL_BITS	4
+#endif
+
+/** Timer0 prescaler. */
+#define	TIMER_PRESCALER	(F_CPU / 64 / TIMER_TICK_HZ <= 256 ? 64 : 256)
+
+/** Timer0 counts per tick. */
+#define	TIMER_COUNTS	((F_CPU / TIMER_PRESCALER + TIMER_TICK_HZ / 2) / TIMER_TICK_HZ)
+
+/** Timer0 count, microseconds * 256. */
+#define	TIMER_COUNT_US_Q8	((uint32_t)(TIMER_PRESCALER * 256.0 * 1000000.0 / F_CPU + 0.5))
+
+/** Actual tick period, microseconds * 256. */
+#define	TIMER_TICK_US_Q8	((uint32_t)(TIMER_COUNTS * TIMER_PRESCALER * 256.0 * 1000000.0 / F_CPU + 0.5))
+
+/** Actual tick period, microseconds, rounded down. */
+#define	TIMER_TICK_US		(TIMER_TICK_US_Q8 >> 8)
+
+/** Convert milliseconds to ticks, rounded up.
+ * \param[in]	ms	Milliseconds.
+ */
+#define	TIMER_MS(ms)	((uint32_t)(((ms) * 256000.0 + TIMER_TICK_US_Q8 - 1) / TIMER_TICK_US_Q8))
+
+/** Timer callback.
+ * \param[in]	arg		Argument given to timer_setup.
+ */
+typedef void (*TIMER_CALLBACK)(void* arg);
+
+/** Software timer. All fields are private to the timer module. */
+typedef struct TIMER_ {
+	/** Next timer in the same slot. */
+	struct TIMER_*	next;
+	/** Link pointing to this timer, NULL when not armed. */
+	struct TIMER_**	pprev;
+	/** Tick of expiry. */
+	uint32_t		expires;
+	/** Period, 0 for one-shot timers. */
+	uint32_t		period;
+	/** Function to call on expiry. */
+	TIMER_CALLBACK	callback;
+	/** Argument to the callback. */
+	void*			arg;
+} TIMER;
+
+/** Start Timer0 and the timebase. Tick count and microseconds start from zero. */
+void
+timer_init(void);
+
+/** Get the number of ticks since timer_init. Can be called from interrupts.
+ * \return		Tick count.
+ */
+uint32_t
+timer_ticks(void);
+
+/** Get the number of microseconds since timer_init, wraps around after 71 minutes.
+ * Can be called from interrupts.
+ * \return		Microseconds.
+ */
+uint32_t
+timer_micros(void);
+
+/** Get a free-running 16-bit count of Timer0 clocks (TIMER_PRESCALER CPU clocks each), for
+ * measuring short intervals. Can be called from interrupts.
+ * \return		Timer0 clocks since timer_init, modulo 2^16.
+ */
+uint16_t
+timer_counts(void);
+
+/** Initialize timer, not armed.
+ * \param[out]	timer		Timer.
+ * \param[in]	callback	Function to call on expiry.
+ * \param[in]	arg			Argument to the callback.
+ */
+void
+timer_setup(
+	TIMER*					timer,
+	const TIMER_CALLBACK	callback,
+	void*					arg
+);
+
+/** Arm timer. Re-arms an armed timer. Can be called from timer callbacks.
+ * \param[in,out]	timer	Timer.
+ * \param[in]		delay	Ticks until expiry, at least 1.
+ * \param[in]		period	Period in ticks for periodic timers, 0 for one-shot timers.
+ */
+void
+timer_arm(
+	TIMER*			timer,
+	const uint32_t	delay,
+	const uint32_t	period
+);
+
+/** Cancel timer. Does nothing when the timer is not armed. Can be called from timer callbacks.
+ * \param[in,out]	timer	Timer.
+ */
+void
+timer_cancel(
+	TIMER*	timer
+);
+
+/** Is the timer armed? */
+bool
+timer_armed(
+	const TIMER*	timer
+);
+
+/** Process the ticks elapsed since the last call and run callbacks of expired timers.
+ * \return		Number of ticks processed.
+ */
+uint16_t
+timer_poll(void);
+
+/** Are there ticks not yet processed by timer_poll? Call with interrupts disabled to decide
+ * whether to sleep.
+ */
+bool
+timer_pending(void);
+
+/** Ticks until the earliest armed timer can expire, a lower bound, to decide how long to sleep.
+ * \return		0 when there are ticks not yet processed by timer_poll, 0xFFFF when no timer is
+ *				armed or none expires within 0xFFFF ticks.
+ */
+uint16_t
+timer_idle_ticks(void);
+
+/** Add ticks that passed while Timer0 was stopped, i.e. in power-down mode (power.h). Timers
+ * expiring meanwhile run at the next timer_poll.
+ * \param[in]	n	Ticks.
+ */
+void
+timer_advance(
+	const uint32_t	n
+);
+
+/** Longest time spent processing one tick in timer_poll, including callbacks.
+ * \return		Microseconds.
+ */
+uint16_t
+timer_poll_max(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* timer_h_ */
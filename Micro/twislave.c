@@ -2,6 +2,10 @@
 #include <Micro/twislave.h>	// ourselves
 #include <util/twi.h>		// TWI bit mask definitions
 #include <avr/interrupt.h>	// ISR
+#include <Micro/isrtrace.h>
+#if defined(TWISLAVE_WITH_PEC)
+#include <Micro/crc.h>
+#endif
 
 /****************************************************************************
   TWI State codes
@@ -73,31 +77,73 @@ static uint8_t	rx_cnt = 0;
 static uint8_t	rx_buf[4];
 /// Register contents obtained by a call to 'twislave_read_callback', if any.
 static uint8_t	tx_buf = 0;
+/// Addressed by the master, transfer not finished yet.
+static volatile bool	addressed = false;
+
+#if defined(TWISLAVE_WITH_PEC)
+/// Own address, write direction.
+#define	SLA_W	(TWAR & 0xFE)
+/// Own address, read direction.
+#define	SLA_R	(SLA_W | 0x01)
+/// PEC of the register read, sent after the data byte.
+static uint8_t	tx_pec = 0;
+/// Number of bytes transmitted in the current read.
+static uint8_t	tx_cnt = 0;
+/// Number of writes dropped because of PEC mismatch.
+static uint16_t	pec_errors = 0;
+
+/*****************************************************************************/
+uint16_t
+twislave_pec_errors()
+{
+	return pec_errors;
+}
+#endif
+
+/*****************************************************************************/
+bool
+twislave_busy()
+{
+	return addressed;
+}
 
 /*****************************************************************************/
 ISR(TWI_vect)
 {
+	ISRTRACE_ENTER(ISRTRACE_TWI);
 	switch (TWSR) {
 	case TWI_STX_ADR_ACK:
 		// Own SLA+R has been received; ACK has been returned
+		addressed = true;
 		rx_cnt = 0;
 		TWDR = tx_buf;
 		TWCR = TWCR_ACK;
+#if defined(TWISLAVE_WITH_PEC)
+		tx_cnt = 1;
+#endif
 		break;
 	case TWI_STX_DATA_ACK:
 		// Data byte in TWDR has been transmitted; ACK has been received
+#if defined(TWISLAVE_WITH_PEC)
+		// Master wants more: PEC follows the data byte.
+		TWDR = tx_cnt == 1 ? tx_pec : tx_buf;
+		++tx_cnt;
+#else
 		TWDR = tx_buf;
+#endif
 		TWCR = TWCR_ACK;
 		break;
 	case TWI_STX_DATA_NACK:
 		// Data byte in TWDR has been transmitted; NACK has been received. 
 		// I.e. this could be the end of the transmission.
+		addressed = false;
 		TWCR =	TWCR_ACK;
 		break;     
 	case TWI_SRX_GEN_ACK:
 		// General call address has been received; ACK has been returned
 	case TWI_SRX_ADR_ACK:
 		// Own SLA+W has been received ACK has been returned
+		addressed = true;
 		rx_cnt   = 0;
 		TWCR = TWCR_ACK;
 		break;
@@ -114,17 +160,32 @@ ISR(TWI_vect)
 	case TWI_SRX_STOP_RESTART:
 		// A STOP condition or repeated START condition has been received while still addressed as Slave    
 		TWCR = TWCR_ACK; // this permits TWI hardware to continue working.
+		addressed = false;
 		switch (rx_cnt) {
 		case 1:
 			tx_buf = twislave_read_callback
 				? twislave_read_callback(rx_buf[0])
 				: 0;
+#if defined(TWISLAVE_WITH_PEC)
+			tx_pec = crc8_byte(crc8_byte(crc8_byte(crc8_byte(CRC8_INIT,
+				SLA_W), rx_buf[0]), SLA_R), tx_buf);
+#endif
 			break;
 		case 2:
 			if (twislave_write_callback) {
 				twislave_write_callback(rx_buf[0], rx_buf[1]);
 			}
 			break;
+#if defined(TWISLAVE_WITH_PEC)
+		case 3:
+			if (crc8_byte(crc8_byte(crc8_byte(CRC8_INIT,
+					SLA_W), rx_buf[0]), rx_buf[1]) != rx_buf[2]) {
+				++pec_errors;
+			} else if (twislave_write_callback) {
+				twislave_write_callback(rx_buf[0], rx_buf[1]);
+			}
+			break;
+#endif
 		}
 		break;           
 	case TWI_SRX_ADR_DATA_NACK:
@@ -136,7 +197,9 @@ ISR(TWI_vect)
 	case TWI_BUS_ERROR:
 		// Bus error due to an illegal START or STOP condition
 	default:     
+		addressed = false;
 		TWCR = TWCR_ACK | _BV(TWSTO);
 	}
+	ISRTRACE_EXIT();
 }
 
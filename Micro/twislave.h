@@ -17,6 +17,12 @@
  *   <li><em>twi_read ADDR 1</em>
  * </ol>
  *
+ * SMBus PEC (CRC-8, see crc.h) is supported when TWISLAVE_WITH_PEC is defined on the compiler's
+ * command line; link crc.o too. Writes <em>[R; D; PEC]</em> are checked against the PEC over the
+ * address byte, R and D and dropped on mismatch; writes without PEC are still accepted. A read of
+ * 2 bytes returns the data followed by the PEC over SLA+W, R, SLA+R and the data, as in the SMBus
+ * "read byte" protocol with a repeated start.
+ *
  * Usage:
  * <ol>
  * 	<li>Initialize TWI by calling <b>twislave_init</b>.
@@ -28,6 +34,7 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +52,18 @@ twislave_init(
 void
 twislave_close();
 
+/** Is a transfer addressed to this slave in progress? The TWI clock may be stopped, i.e. by
+ * sleeping in power-down mode, only when not; an address match wakes the MCU up.
+ */
+bool
+twislave_busy();
+
+#if defined(TWISLAVE_WITH_PEC)
+/** Number of writes dropped because of a PEC mismatch. */
+uint16_t
+twislave_pec_errors();
+#endif
+
 /** This function is called when TWI master writes to the register. It is run with interrupts disabled.
  * It is not terribly time-critical, however, long operations should be avoided.
  *
@@ -11,6 +11,11 @@ vim: shiftwidth=2
 #include <Micro/CBuffer.h>
 #include <Micro/uart.h>
 
+#if defined(ISRTRACE_NO_UART)
+#undef MICRO_ISR_TRACE
+#endif
+#include <Micro/isrtrace.h>
+
 #if defined (__AVR_ATmega644__)
 /** Internal use only: Use new USART interface? */
 #define	MICRO_NEW_INTERFACE
@@ -59,21 +64,26 @@ uart_close()
 #if defined(MICRO_NEW_INTERFACE)
 	UCSR0B = 0x00;
 #else
-	UCSRC = 0x00;
+	UCSRB = 0x00;
 #endif
 }
 
+/** Bytes received, wraps. */
+static volatile uint8_t	rx_count = 0;
+
 /*****************************************************************************/
 /** Byte received on UART. */
 #if defined(MICRO_NEW_INTERFACE)
 SIGNAL(SIG_USART_RECV)
 {
+	ISRTRACE_ENTER(ISRTRACE_USART_RX);
 	for (;;) {
 		/* Check flags. */
 		const uint8_t	flags = UCSR0A;
 		if (flags & (1<<RXC0)) {
 			/* Read byte. */
 			const uint8_t	udr = UDR0;
+			++rx_count;
 			if (uart_read_callback) {
 				uart_read_callback(udr);
 			}
@@ -82,16 +92,19 @@ SIGNAL(SIG_USART_RECV)
 			break;
 		}
 	}
+	ISRTRACE_EXIT();
 }
 #else
 ISR(USART_RXC_vect)
 {
+	ISRTRACE_ENTER(ISRTRACE_USART_RX);
 	for (;;) {
 		/* Check flags. */
 		const uint8_t	flags = UCSRA;
 		if (flags & _BV(RXC)) {
 			/* Read byte. */
 			const uint8_t	udr = UDR;
+			++rx_count;
 			if (uart_read_callback) {
 				uart_read_callback(udr);
 			}
@@ -100,41 +113,105 @@ ISR(USART_RXC_vect)
 			break;
 		}
 	}
+	ISRTRACE_EXIT();
 }
 #endif
 
 /*****************************************************************************/
 static CBuffer<uint8_t, 128>	tx_buffer;
+/** A byte has been handed to the UART and its transmission has not been seen complete. */
+static volatile bool	tx_busy = false;
+
+#if defined(UART_WITH_BLOCKS)
+#if !defined(UART_BLOCK_QUEUE_SIZE)
+/** Number of slots in the block queue, one is always unused. */
+#define	UART_BLOCK_QUEUE_SIZE	4
+#endif
+
+/** Block queued by uart_send_block. */
+typedef struct {
+	const uint8_t*		data;
+	uint8_t						length;
+	UART_BLOCK_DONE		done;
+	void*							arg;
+} UART_BLOCK;
+
+static CBuffer<UART_BLOCK, UART_BLOCK_QUEUE_SIZE>	tx_blocks;
+/** Block being transmitted, length 0 when none. */
+static UART_BLOCK		tx_block;
+#endif
+
+/*****************************************************************************/
+/** Next byte to transmit: the block in progress, then the ring, then the next block. */
+static inline bool
+tx_next(	uint8_t&	c)
+{
+#if defined(UART_WITH_BLOCKS)
+	if (tx_block.length == 0 && tx_buffer.IsEmpty()) {
+		tx_blocks.Pop(tx_block);
+	}
+	if (tx_block.length > 0) {
+		c = *tx_block.data++;
+		if (--tx_block.length == 0 && tx_block.done) {
+			tx_block.done(tx_block.arg);
+		}
+		return true;
+	}
+#endif
+	return tx_buffer.Pop(c);
+}
+
+/*****************************************************************************/
+/** Is there nothing left to transmit? */
+static inline bool
+tx_idle()
+{
+#if defined(UART_WITH_BLOCKS)
+	return tx_buffer.IsEmpty() && tx_block.length == 0 && tx_blocks.IsEmpty();
+#else
+	return tx_buffer.IsEmpty();
+#endif
+}
 
 /*****************************************************************************/
 /** Data register empty: more work to do. */
 #if defined(MICRO_NEW_INTERFACE)
 SIGNAL(SIG_USART_DATA)
 {
+	ISRTRACE_ENTER(ISRTRACE_USART_UDRE);
 	uint8_t	txchar;
-	if (tx_buffer.Pop(txchar)) {
+	if (tx_next(txchar)) {
 #if defined(UART_RS485_PORT) && defined(UART_RS485_PIN)
 		UART_RS485_PORT |= _BV(UART_RS485_PIN);
 #endif
 		UDR0 = txchar;
+		// Transmit complete is to be seen for this byte; U2X0 and MPCM0 are kept.
+		tx_busy = true;
+		UCSR0A = (UCSR0A & ((1<<U2X0) | (1<<MPCM0))) | (1<<TXC0);
 	} else {
 		// Disable DataRegisterEmpty interrupt.
 		UCSR0B &= ~(1<<UDRIE0);
 	}
+	ISRTRACE_EXIT();
 }
 #else
 ISR(USART_UDRE_vect)
 {
+	ISRTRACE_ENTER(ISRTRACE_USART_UDRE);
 	uint8_t	txchar;
-	if (tx_buffer.Pop(txchar)) {
+	if (tx_next(txchar)) {
 #if defined(UART_RS485_PORT) && defined(UART_RS485_PIN)
 		UART_RS485_PORT |= _BV(UART_RS485_PIN);
 #endif
 		UDR = txchar;
+		// Transmit complete is to be seen for this byte; U2X and MPCM are kept.
+		tx_busy = true;
+		UCSRA = (UCSRA & (_BV(U2X) | _BV(MPCM))) | _BV(TXC);
 	} else {
 		// Disable DataRegisterEmpty interrupt.
 		UCSRB &= ~_BV(UDRIE);
 	}
+	ISRTRACE_EXIT();
 }
 #endif
 
@@ -146,10 +223,13 @@ SIGNAL(SIG_USART_TRANS)
 ISR(USART_TXC_vect)
 #endif // MICRO_NEW_INTERFACE
 {
-	if (tx_buffer.IsEmpty())
+	ISRTRACE_ENTER(ISRTRACE_USART_TX);
+	if (tx_idle())
 	{
 		UART_RS485_PORT &= ~_BV(UART_RS485_PIN);
+		tx_busy = false;
 	}
+	ISRTRACE_EXIT();
 }
 #endif // RS485
 
@@ -170,6 +250,71 @@ uart_putchar(	const uint8_t	c)
 	ENABLE_DATA_REGISTER_EMPTY();
 }
 
+/*****************************************************************************/
+uint8_t
+uart_tx_free()
+{
+	return tx_buffer.Free();
+}
+
+/*****************************************************************************/
+uint8_t
+uart_rx_count()
+{
+	return rx_count;
+}
+
+/*****************************************************************************/
+bool
+uart_tx_idle()
+{
+	const uint8_t	sreg = SREG;
+	cli();
+#if !(defined(UART_RS485_PORT) && defined(UART_RS485_PIN))
+	// The transmit complete interrupt is not used, the flag stays set.
+#if defined(MICRO_NEW_INTERFACE)
+	if (tx_busy && (UCSR0A & (1<<TXC0))) {
+#else
+	if (tx_busy && (UCSRA & _BV(TXC))) {
+#endif
+		tx_busy = false;
+	}
+#endif
+	const bool	r = !tx_busy && tx_idle();
+	SREG = sreg;
+	return r;
+}
+
+/*****************************************************************************/
+#if defined(UART_WITH_BLOCKS)
+bool
+uart_send_block(
+	const uint8_t*				data,
+	const uint8_t					length,
+	const UART_BLOCK_DONE	done,
+	void*									arg
+)
+{
+	if (length == 0) {
+		if (done) {
+			done(arg);
+		}
+		return true;
+	}
+
+	UART_BLOCK	block;
+	block.data		= data;
+	block.length	= length;
+	block.done		= done;
+	block.arg			= arg;
+	if (!tx_blocks.Push(block)) {
+		return false;
+	}
+	ENABLE_DATA_REGISTER_EMPTY();
+	return true;
+}
+#endif
+
 /*****************************************************************************/
 void
 uart_send_P(	PGM_P	s)
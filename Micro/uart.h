@@ -7,6 +7,7 @@
 
 #include <avr/io.h>				/* IO ports */
 #include <stdint.h>				/* uint8_t */
+#include <stdbool.h>			/* bool */
 #include <avr/pgmspace.h>	/* Program memory space. */
 
 #if defined(__cplusplus)
@@ -38,6 +39,47 @@ void uart_close();
  */
 void uart_putchar(	const uint8_t	c);
 
+/**
+ * Number of bytes that can be queued for transmission without loss.
+ */
+uint8_t uart_tx_free();
+
+/**
+ * Has everything been sent, up to the stop bit of the last byte? The clock may be stopped,
+ * i.e. by sleeping in power-down mode, only then.
+ */
+bool uart_tx_idle();
+
+/**
+ * Number of bytes received, wrapping at 256. A change shows reception since the last call.
+ */
+uint8_t uart_rx_count();
+
+/** Called from the interrupt when the last byte of a block has been handed to the UART;
+ * the block may be reused or freed.
+ * \param[in]	arg	Argument given to uart_send_block.
+ */
+typedef void (*UART_BLOCK_DONE)(void* arg);
+
+/** Queue a block for transmission without copying it into the transmit ring. Available when
+ * UART_WITH_BLOCKS is defined on the compiler's command line. Main loop only.
+ *
+ * Blocks are sent in order, each one when the transmit ring is empty; bytes written with
+ * uart_putchar while a block is queued go out before it. The queue holds 3 blocks by default,
+ * define UART_BLOCK_QUEUE_SIZE (slots + 1) to change it.
+ * \param[in]	data		Bytes to send, must stay valid until \c done is called.
+ * \param[in]	length	Number of bytes.
+ * \param[in]	done		Function to call when the block has been sent, or 0.
+ * \param[in]	arg			Argument to \c done.
+ * \return		true when queued, false when the queue is full.
+ */
+bool uart_send_block(
+	const uint8_t*				data,
+	const uint8_t					length,
+	const UART_BLOCK_DONE	done,
+	void*									arg
+);
+
 /**
  * Print strings to debugging output.
  */
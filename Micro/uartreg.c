@@ -0,0 +1,176 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <Micro/frame.h>
+#include <Micro/shared.h>
+#include <Micro/twislave.h>
+#include <Micro/uart.h>
+#include <Micro/uartreg.h>	// ourselves
+
+static FRAME_DECODER	dec;
+/// Is dec.frame a request for this node waiting to be carried out?
+static volatile bool	ready = false;
+/// Node address.
+static uint8_t			node = 0;
+/// Bytes dropped while a request was waiting.
+static uint16_t			dropped = 0;
+
+/*****************************************************************************/
+void
+uartreg_init(
+	const uint8_t	node_address
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	frame_decoder_init(&dec);
+	ready = false;
+	node = node_address;
+	dropped = 0;
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+uartreg_input(
+	const uint8_t	c
+)
+{
+	if (ready) {
+		++dropped;
+	} else if (frame_decode(&dec, c)
+		&& (dec.frame.address == node || dec.frame.address == FRAME_BROADCAST)) {
+		ready = true;
+	}
+}
+
+/*****************************************************************************/
+static uint8_t
+read_register(
+	const uint8_t	register_no
+)
+{
+	uint8_t			r = 0;
+	const uint8_t	sreg = SREG;
+	cli();
+	if (twislave_read_callback) {
+		r = twislave_read_callback(register_no);
+	}
+	SREG = sreg;
+	return r;
+}
+
+/*****************************************************************************/
+static void
+write_register(
+	const uint8_t	register_no,
+	const uint8_t	data
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+	if (twislave_write_callback) {
+		twislave_write_callback(register_no, data);
+	}
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+bool
+uartreg_poll(void)
+{
+	if (!ready) {
+		return false;
+	}
+
+	const FRAME*	f = &dec.frame;
+	const bool		broadcast = f->address == FRAME_BROADCAST;
+	const uint8_t	command = f->command;
+	const uint8_t	length = f->length;
+	const uint8_t*	p = f->payload;
+
+	// Length of the reply, checked first so that nothing is carried out without the reply.
+	uint8_t			n = 1;
+	uint8_t			status = UARTREG_OK;
+	switch (command) {
+	case UARTREG_CMD_READ:
+		if (length != 2 || p[1] > FRAME_MAX_PAYLOAD - 1) {
+			status = UARTREG_BAD_LENGTH;
+		} else {
+			n += p[1];
+		}
+		break;
+	case UARTREG_CMD_WRITE:
+		if (length < 1) {
+			status = UARTREG_BAD_LENGTH;
+		}
+		break;
+	case UARTREG_CMD_GATHER:
+		if (length > FRAME_MAX_PAYLOAD - 1) {
+			status = UARTREG_BAD_LENGTH;
+		} else {
+			n += length;
+		}
+		break;
+	case UARTREG_CMD_SCATTER:
+		if (length & 1) {
+			status = UARTREG_BAD_LENGTH;
+		}
+		break;
+	default:
+		status = UARTREG_BAD_COMMAND;
+		break;
+	}
+	if (broadcast && (command == UARTREG_CMD_READ || command == UARTREG_CMD_GATHER)) {
+		ready = false;
+		return true;
+	}
+	if (!broadcast && uart_tx_free() < FRAME_OVERHEAD + n) {
+		// Wait for room, the reply must not be lost.
+		return false;
+	}
+
+	uint8_t	reply[FRAME_MAX_PAYLOAD];
+	reply[0] = status;
+	if (status == UARTREG_OK) {
+		switch (command) {
+		case UARTREG_CMD_READ:
+			for (uint8_t i=0; i<p[1]; ++i) {
+				reply[1 + i] = read_register(p[0] + i);
+			}
+			break;
+		case UARTREG_CMD_WRITE:
+			for (uint8_t i=1; i<length; ++i) {
+				write_register(p[0] + i - 1, p[i]);
+			}
+			break;
+		case UARTREG_CMD_GATHER:
+			for (uint8_t i=0; i<length; ++i) {
+				reply[1 + i] = read_register(p[i]);
+			}
+			break;
+		case UARTREG_CMD_SCATTER:
+			for (uint8_t i=0; i<length; i+=2) {
+				write_register(p[i], p[i + 1]);
+			}
+			break;
+		}
+	} else {
+		n = 1;
+	}
+
+	// The frame has been used up, the next request may come in.
+	ready = false;
+	if (!broadcast) {
+		frame_send(uart_putchar, node, command | UARTREG_REPLY, reply, n);
+	}
+	return true;
+}
+
+/*****************************************************************************/
+uint16_t
+uartreg_dropped(void)
+{
+	return shared_load16(&dropped);
+}
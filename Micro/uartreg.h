@@ -0,0 +1,93 @@
+// vim: ts=4 shiftwidth=4
+#ifndef uartreg_h_
+#define uartreg_h_
+
+/** \file
+ * Register access over UART and RS485: the 256 8-bit registers of twislave.h, reached through
+ * the same <b>twislave_read_callback</b> and <b>twislave_write_callback</b>, thus one register map
+ * serves both buses. TWI itself need not be used.
+ *
+ * Requests and replies are frames (see frame.h) addressed to one node; broadcast writes are
+ * carried out but not answered, broadcast reads are ignored. The reply has the command plus
+ * UARTREG_REPLY, its first payload byte is a status, UARTREG_OK on success.
+ * <ol>
+ *   <li>UARTREG_CMD_READ: first register, count. Reply: status, count values of consecutive
+ *   registers. Registers wrap around from 255 to 0.
+ *   <li>UARTREG_CMD_WRITE: first register, values of consecutive registers. Reply: status.
+ *   <li>UARTREG_CMD_GATHER: list of registers. Reply: status, their values in the same order.
+ *   <li>UARTREG_CMD_SCATTER: list of register, value pairs, written in order. Reply: status.
+ * </ol>
+ * At most FRAME_MAX_PAYLOAD - 1 registers per read or gather (63 by default), so that a host
+ * polls a full status block in one round trip. Each callback runs with interrupts disabled, as
+ * from the TWI interrupt; a multi-byte value should be latched by the callbacks, i.e. on reading
+ * its first byte, to be consistent.
+ *
+ * The host tool is host/regtool.
+ *
+ * Usage:
+ * <ol>
+ *   <li>Implement <b>twislave_read_callback</b> and <b>twislave_write_callback</b>.
+ *   <li>Setup UART by calling <b>uart_setup</b>, then call <b>uartreg_init</b>.
+ *   <li>Implement <b>uart_read_callback</b> to call <b>uartreg_input</b>.
+ *   <li>Call <b>uartreg_poll</b> from the main loop.
+ * </ol>
+ * Replies are sent with uart_putchar, FRAME_MAX_PAYLOAD + FRAME_OVERHEAD must fit into the UART
+ * transmit buffer.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Read consecutive registers. */
+#define	UARTREG_CMD_READ		0x10
+/** Write consecutive registers. */
+#define	UARTREG_CMD_WRITE		0x11
+/** Read a list of registers. */
+#define	UARTREG_CMD_GATHER		0x12
+/** Write a list of registers. */
+#define	UARTREG_CMD_SCATTER		0x13
+/** Added to the command in replies. */
+#define	UARTREG_REPLY			0x80
+
+/** Success. */
+#define	UARTREG_OK				0x00
+/** Payload too short or too long. */
+#define	UARTREG_BAD_LENGTH		0x02
+/** Unknown command. */
+#define	UARTREG_BAD_COMMAND		0x03
+
+/** Initialize.
+ * \param[in]	node	Node address, 0..254.
+ */
+void
+uartreg_init(
+	const uint8_t	node
+);
+
+/** Feed a received byte. Call from the UART receive interrupt, i.e. uart_read_callback. Bytes
+ * arriving while a request is waiting for uartreg_poll are dropped.
+ */
+void
+uartreg_input(
+	const uint8_t	c
+);
+
+/** Carry out a received request and send the reply. Call from the main loop.
+ * \return		true when a request has been carried out.
+ */
+bool
+uartreg_poll(void);
+
+/** Number of bytes dropped because a request was waiting. */
+uint16_t
+uartreg_dropped(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* uartreg_h_ */
@@ -0,0 +1,196 @@
+// vim: ts=4 shiftwidth=4
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include <Micro/DAC8560.h>
+#include <Micro/isrtrace.h>
+#include <Micro/shared.h>
+#include <Micro/waveform.h>	// ourselves
+
+#if !defined(TIMSK2)
+#error waveform requires Timer2 with CTC mode (ATmega88, ATmega644, etc).
+#endif
+
+/** Sine, 256 entries, full scale 32767. */
+static const int16_t	sine_table[256] PROGMEM = {
+	     0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+	  6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+	 12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+	 18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+	 23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+	 27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+	 30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+	 32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+	 32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+	 32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+	 30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+	 27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+	 23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+	 18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+	 12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+	  6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+	     0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+	 -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+	 -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+};
+
+/// Setups, the front one is in use.
+static WAVEFORM_SETUP		setups[2];
+/// Front and back setup. The interrupt publishes the back one when a commit is pending.
+static DOUBLEBUF			buffer;
+/// Activate the back setup at the next phase wrap.
+static volatile bool		commit_pending = false;
+/// Back setup has not been refreshed since the last commit.
+static volatile bool		stale = false;
+/// Phase accumulator.
+static uint32_t				phase = 0;
+/// Phase increment per sample.
+static volatile uint32_t	tuning_word = 0;
+/// Code to be written by the next interrupt.
+static uint16_t				next_code = 0x8000;
+
+/*****************************************************************************/
+static int16_t
+sample_of(
+	const WAVEFORM_SETUP*	setup,
+	const uint32_t			p
+)
+{
+	const uint8_t	index = (uint8_t)(p >> 24);
+	switch (setup->source) {
+	case WAVEFORM_SINE:
+		return (int16_t)pgm_read_word(&sine_table[index]);
+	case WAVEFORM_TRIANGLE:
+		{
+			const uint16_t	p16 = (uint16_t)(p >> 16);
+			uint16_t		t = p16 << 1;
+			if (p16 & 0x8000) {
+				t = ~t;
+			}
+			return (int16_t)(t - 0x8000);
+		}
+	case WAVEFORM_TABLE_P:
+		return (int16_t)pgm_read_word(&setup->table[index >> (8 - setup->table_bits)]);
+	case WAVEFORM_TABLE:
+		return setup->table[index >> (8 - setup->table_bits)];
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+ISR(TIMER2_COMPA_vect)
+{
+	ISRTRACE_ENTER_LATENCY(ISRTRACE_TIMER2_COMPA, TCNT2 * 8);
+	// Constant latency from the compare match to the DAC update.
+	DAC8560_Write(next_code);
+
+	const uint32_t	previous = phase;
+	phase += tuning_word;
+	if (commit_pending && (phase < previous || tuning_word == 0)) {
+		doublebuf_publish(&buffer);
+		commit_pending = false;
+		stale = true;
+	}
+
+	const WAVEFORM_SETUP*	setup = &setups[doublebuf_front(&buffer)];
+	const int32_t			code = (int32_t)setup->offset
+		+ (((int32_t)sample_of(setup, phase) * setup->amplitude) >> 15);
+	next_code = code < 0
+		? 0
+		: (code > 0xFFFF ? 0xFFFF : (uint16_t)code);
+	ISRTRACE_EXIT();
+}
+
+/*****************************************************************************/
+void
+waveform_start(
+	const uint8_t	period,
+	const uint32_t	tuning
+)
+{
+	const uint8_t	sreg = SREG;
+	cli();
+
+	setups[0].source		= WAVEFORM_SINE;
+	setups[0].table			= 0;
+	setups[0].table_bits	= 8;
+	setups[0].amplitude		= 0x7FFF;
+	setups[0].offset		= 0x8000;
+	setups[1] = setups[0];
+	doublebuf_init(&buffer);
+	commit_pending = false;
+	stale = false;
+	phase = 0;
+	tuning_word = tuning;
+	next_code = 0x8000;
+
+	// CTC mode with OCR2A as TOP, clock F_CPU/8.
+	TCCR2A = (1<<WGM21);
+	TCCR2B = 0x00;
+	TCNT2 = 0;
+	OCR2A = period;
+	TIMSK2 |= (1<<OCIE2A);
+	TCCR2B = (1<<CS21);
+
+	SREG = sreg;
+}
+
+/*****************************************************************************/
+void
+waveform_stop(void)
+{
+	TCCR2B = 0x00;
+	TIMSK2 &= ~(1<<OCIE2A);
+}
+
+/*****************************************************************************/
+void
+waveform_set_frequency(
+	const uint32_t	tuning
+)
+{
+	shared_store32(&tuning_word, tuning);
+}
+
+/*****************************************************************************/
+WAVEFORM_SETUP*
+waveform_edit(void)
+{
+	if (commit_pending) {
+		return 0;
+	}
+	WAVEFORM_SETUP*	inactive = &setups[doublebuf_back(&buffer)];
+	if (stale) {
+		*inactive = setups[doublebuf_front(&buffer)];
+		stale = false;
+	}
+	return inactive;
+}
+
+/*****************************************************************************/
+void
+waveform_commit(void)
+{
+	commit_pending = true;
+}
+
+/*****************************************************************************/
+bool
+waveform_commit_pending(void)
+{
+	return commit_pending;
+}
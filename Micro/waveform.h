@@ -0,0 +1,121 @@
+// vim: ts=4 shiftwidth=4
+#ifndef waveform_h_
+#define waveform_h_
+
+/** \file
+ * Timer-driven waveform playback on DAC8560. Timer2 runs in CTC mode at F_CPU/8 and the
+ * compare interrupt writes one sample per period. The sample written in the interrupt was
+ * computed in the previous interrupt, thus the DAC update does not depend on the waveform.
+ *
+ * Waveforms are produced by direct digital synthesis: a 32-bit phase accumulator is advanced
+ * by the tuning word every sample, the upper bits of the phase index the waveform table.
+ * Frequency resolution is sample_rate / 2^32.
+ *
+ * Sources:
+ * <ol>
+ *   <li>WAVEFORM_SINE: built-in 256-entry PROGMEM table.
+ *   <li>WAVEFORM_TRIANGLE: computed from the phase.
+ *   <li>WAVEFORM_TABLE_P: user table of 2^table_bits entries in program memory.
+ *   <li>WAVEFORM_TABLE: user table of 2^table_bits entries in RAM.
+ * </ol>
+ * Table entries are signed 16-bit. The DAC code is offset + entry * amplitude / 32768,
+ * clamped to [0, 65535].
+ *
+ * The setup is double-buffered: <b>waveform_edit</b> returns the inactive setup, and
+ * <b>waveform_commit</b> activates it at the next phase wrap, thus without a glitch. To swap
+ * RAM waveforms, point the inactive setup to a second table; do not modify the active table.
+ *
+ * DAC8560 must be initialized before calling <b>waveform_start</b>; DAC8560_WITHOUT_IRQ gives
+ * the lowest cost per sample. The cost per sample has NOT been measured yet; estimated by
+ * instruction count, a sample takes roughly 250 of the 500 cycles available at 10 MHz and 20 kHz
+ * sample rate. To measure, build with MICRO_ISR_TRACE, ISRTRACE_CLOCK()=TCNT1 and
+ * ISRTRACE_CLOCK_DIV=1 with Timer1 running free at F_CPU/1, and read the duration of
+ * ISRTRACE_TIMER2_COMPA with host/isrtrace.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/** Calculate Timer2 period for the given sample rate.
+ * \param[in]	f_cpu	CPU clock, Hz. Use F_CPU, if defined.
+ * \param[in]	hz		Sample rate, Hz. From f_cpu/2048 to about f_cpu/400.
+ */
+#define	WAVEFORM_PERIOD(f_cpu, hz)	((f_cpu)/((hz)*8l)-1)
+
+/** Calculate tuning word for the given output frequency.
+ * \param[in]	sample_rate	Sample rate, Hz.
+ * \param[in]	hz			Output frequency, Hz. Less than sample_rate / 2.
+ */
+#define	WAVEFORM_TUNING(sample_rate, hz)	((uint32_t)((hz) * 4294967296.0 / (sample_rate)))
+
+typedef enum {
+	/** Built-in sine table. */
+	WAVEFORM_SINE,
+	/** Computed triangle. */
+	WAVEFORM_TRIANGLE,
+	/** User table in program memory. */
+	WAVEFORM_TABLE_P,
+	/** User table in RAM. */
+	WAVEFORM_TABLE
+} WAVEFORM_SOURCE;
+
+/** Waveform setup. */
+typedef struct {
+	/** Waveform source. */
+	WAVEFORM_SOURCE	source;
+	/** Table for WAVEFORM_TABLE_P and WAVEFORM_TABLE. */
+	const int16_t*	table;
+	/** Table has 2^table_bits entries, 1..8. */
+	uint8_t			table_bits;
+	/** Amplitude, 32767 is full scale. */
+	int16_t			amplitude;
+	/** DAC code of zero. */
+	uint16_t		offset;
+} WAVEFORM_SETUP;
+
+/** Start playback. The active setup is a full scale sine around mid-scale.
+ * \param[in]	period	Timer2 period, use WAVEFORM_PERIOD to calculate one.
+ * \param[in]	tuning	Tuning word, use WAVEFORM_TUNING to calculate one.
+ */
+void
+waveform_start(
+	const uint8_t	period,
+	const uint32_t	tuning
+);
+
+/** Stop playback. The DAC keeps the last value. */
+void
+waveform_stop(void);
+
+/** Change frequency, phase-continuous.
+ * \param[in]	tuning	Tuning word, use WAVEFORM_TUNING to calculate one.
+ */
+void
+waveform_set_frequency(
+	const uint32_t	tuning
+);
+
+/** Get the inactive setup for modification. It holds a copy of the active setup after
+ * every commit.
+ * \return		Inactive setup. NULL while a commit is pending.
+ */
+WAVEFORM_SETUP*
+waveform_edit(void);
+
+/** Activate the inactive setup at the next phase wrap. */
+void
+waveform_commit(void);
+
+/** Is a commit pending? */
+bool
+waveform_commit_pending(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* waveform_h_ */
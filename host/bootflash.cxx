@@ -0,0 +1,344 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Programmer for the serial bootloader (see Micro/bootloader.h): sends an Intel HEX image over a
+ * serial port, verifies it with a CRC and starts the application.
+ *
+ * Usage:
+ *   bootflash [-p port] [-b baud] [-a node[,node...]] image.hex
+ * Defaults: /dev/ttyUSB0, 38400 baud, node 1. With one node, every write is acknowledged and the
+ * next chunk is sent while the previous page is programmed. With several nodes, writes are
+ * broadcast, paced by the page write time, and each node is verified and started in turn.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <Micro/crc.h>
+#include <Micro/frame.h>
+#include <Micro/bootloader.h>
+
+/// Number of attempts per request.
+#define	RETRIES		3
+/// Reply timeout, ms.
+#define	TIMEOUT_MS	500
+/// Page erase and write time, ms, with margin.
+#define	PAGE_MS		12
+
+static int				port = -1;
+static FRAME_DECODER	dec;
+/// Baud rate.
+static unsigned long	baud = 38400;
+
+/*****************************************************************************/
+static void
+put(
+	const uint8_t	c
+)
+{
+	if (write(port, &c, 1) != 1) {
+		perror("write");
+		exit(1);
+	}
+}
+
+/*****************************************************************************/
+static speed_t
+speed_of(
+	const unsigned long	b
+)
+{
+	switch (b) {
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	default:
+		fprintf(stderr, "Unsupported baud rate %lu\n", b);
+		exit(1);
+	}
+}
+
+/*****************************************************************************/
+static bool
+load_hex(
+	const char*				filename,
+	std::vector<uint8_t>&	image
+)
+{
+	FILE*	f = fopen(filename, "r");
+	if (f == 0) {
+		perror(filename);
+		return false;
+	}
+	char			line[600];
+	unsigned long	base = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] != ':') {
+			continue;
+		}
+		unsigned	bytes[300];
+		unsigned	n = 0;
+		for (const char* p=line+1; p[0] && p[1] && p[0] != '\r' && p[0] != '\n' && n < 300; p+=2) {
+			sscanf(p, "%2x", &bytes[n++]);
+		}
+		unsigned	sum = 0;
+		for (unsigned i=0; i<n; ++i) {
+			sum += bytes[i];
+		}
+		if (n < 5 || n != bytes[0] + 5u || (sum & 0xFF) != 0) {
+			fprintf(stderr, "%s: bad record: %s", filename, line);
+			fclose(f);
+			return false;
+		}
+		const unsigned	address = (bytes[1] << 8) | bytes[2];
+		switch (bytes[3]) {
+		case 0x00:
+			for (unsigned i=0; i<bytes[0]; ++i) {
+				const unsigned long	a = base + address + i;
+				if (a >= image.size()) {
+					image.resize(a + 1, 0xFF);
+				}
+				image[a] = bytes[4 + i];
+			}
+			break;
+		case 0x02:
+			base = ((bytes[4] << 8) | bytes[5]) << 4;
+			break;
+		case 0x04:
+			base = static_cast<unsigned long>((bytes[4] << 8) | bytes[5]) << 16;
+			break;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+/*****************************************************************************/
+/** Wait for the reply to \c command from \c node. */
+static bool
+wait_reply(
+	const uint8_t	node,
+	const uint8_t	command,
+	FRAME&			reply
+)
+{
+	for (;;) {
+		struct pollfd	pfd;
+		pfd.fd = port;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, TIMEOUT_MS) <= 0) {
+			return false;
+		}
+		uint8_t		c;
+		if (read(port, &c, 1) != 1) {
+			return false;
+		}
+		if (frame_decode(&dec, c)
+			&& dec.frame.address == node
+			&& dec.frame.command == (command | BOOT_REPLY)
+			&& dec.frame.length >= 1) {
+			reply = dec.frame;
+			return true;
+		}
+	}
+}
+
+/*****************************************************************************/
+/** Send a request and wait for a successful reply, with retries. */
+static bool
+request(
+	const uint8_t	node,
+	const uint8_t	command,
+	const uint8_t*	payload,
+	const uint8_t	length,
+	FRAME&			reply
+)
+{
+	for (int attempt=0; attempt<RETRIES; ++attempt) {
+		frame_send(put, node, command, payload, length);
+		if (wait_reply(node, command, reply)) {
+			if (reply.payload[0] == BOOT_OK) {
+				return true;
+			}
+			fprintf(stderr, "node %u: command 0x%02X: status %u\n", node, command, reply.payload[0]);
+			return false;
+		}
+	}
+	fprintf(stderr, "node %u: command 0x%02X: no reply\n", node, command);
+	return false;
+}
+
+/*****************************************************************************/
+/** Send one page in chunks. With \c node FRAME_BROADCAST, no replies are expected. */
+static bool
+send_page(
+	const uint8_t				node,
+	const std::vector<uint8_t>&	image,
+	const unsigned				page,
+	const unsigned				page_size,
+	const unsigned				chunk
+)
+{
+	for (int attempt=0; attempt<RETRIES; ++attempt) {
+		bool	ok = true;
+		for (unsigned offset=0; offset<page_size && ok; offset+=chunk) {
+			const unsigned	address = page + offset;
+			uint8_t			payload[2 + 255];
+			payload[0] = address & 0xFF;
+			payload[1] = address >> 8;
+			memcpy(payload + 2, &image[address], chunk);
+			frame_send(put, node, BOOT_CMD_WRITE, payload, 2 + chunk);
+
+			FRAME	reply;
+			if (node == FRAME_BROADCAST) {
+				// Transmission time, plus the page write after the last chunk.
+				tcdrain(port);
+				usleep(offset + chunk >= page_size ? PAGE_MS * 1000 : 1000);
+			} else if (!wait_reply(node, BOOT_CMD_WRITE, reply) || reply.payload[0] != BOOT_OK) {
+				// Restart the page from its first chunk.
+				ok = false;
+			}
+		}
+		if (ok) {
+			return true;
+		}
+	}
+	fprintf(stderr, "node %u: page 0x%04X failed\n", node, page);
+	return false;
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	const char*				device = "/dev/ttyUSB0";
+	std::vector<uint8_t>	nodes;
+	const char*				filename = 0;
+
+	for (int i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			device = argv[++i];
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baud = strtoul(argv[++i], 0, 0);
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			for (char* p=argv[++i]; *p; ) {
+				nodes.push_back(static_cast<uint8_t>(strtoul(p, &p, 0)));
+				if (*p == ',') {
+					++p;
+				}
+			}
+		} else {
+			filename = argv[i];
+		}
+	}
+	if (filename == 0) {
+		fprintf(stderr, "Usage: bootflash [-p port] [-b baud] [-a node[,node...]] image.hex\n");
+		return 1;
+	}
+	if (nodes.empty()) {
+		nodes.push_back(1);
+	}
+
+	std::vector<uint8_t>	image;
+	if (!load_hex(filename, image)) {
+		return 1;
+	}
+
+	port = open(device, O_RDWR | O_NOCTTY);
+	if (port < 0) {
+		perror(device);
+		return 1;
+	}
+	struct termios	tio;
+	tcgetattr(port, &tio);
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed_of(baud));
+	cfsetospeed(&tio, speed_of(baud));
+	tcsetattr(port, TCSANOW, &tio);
+	tcflush(port, TCIOFLUSH);
+	frame_decoder_init(&dec);
+
+	// All nodes must agree on the geometry.
+	unsigned	page_size = 0;
+	unsigned	chunk = 0;
+	unsigned	app_end = 0;
+	for (size_t i=0; i<nodes.size(); ++i) {
+		FRAME	reply;
+		if (!request(nodes[i], BOOT_CMD_PING, 0, 0, reply) || reply.length < 7) {
+			return 1;
+		}
+		const unsigned	p = reply.payload[2] | (reply.payload[3] << 8);
+		const unsigned	c = reply.payload[4];
+		const unsigned	e = reply.payload[5] | (reply.payload[6] << 8);
+		if (i > 0 && (p != page_size || c != chunk || e != app_end)) {
+			fprintf(stderr, "node %u: different flash geometry\n", nodes[i]);
+			return 1;
+		}
+		page_size = p;
+		chunk = c;
+		app_end = e;
+	}
+	if (page_size == 0 || chunk == 0 || page_size % chunk != 0) {
+		fprintf(stderr, "Bad geometry: page %u, chunk %u\n", page_size, chunk);
+		return 1;
+	}
+
+	image.resize((image.size() + page_size - 1) / page_size * page_size, 0xFF);
+	if (image.size() > app_end) {
+		fprintf(stderr, "Image of %lu bytes does not fit below 0x%04X\n",
+			static_cast<unsigned long>(image.size()), app_end);
+		return 1;
+	}
+
+	const uint8_t	target = nodes.size() == 1 ? nodes[0] : FRAME_BROADCAST;
+	for (unsigned page=0; page<image.size(); page+=page_size) {
+		if (!send_page(target, image, page, page_size, chunk)) {
+			return 1;
+		}
+		fprintf(stderr, "\r%u/%lu", page + page_size, static_cast<unsigned long>(image.size()));
+	}
+	fprintf(stderr, "\n");
+
+	const uint16_t	crc = crc16_update(CRC16_INIT, &image[0], image.size());
+	int				failed = 0;
+	for (size_t i=0; i<nodes.size(); ++i) {
+		uint8_t	payload[2];
+		payload[0] = image.size() & 0xFF;
+		payload[1] = image.size() >> 8;
+		FRAME	reply;
+		if (!request(nodes[i], BOOT_CMD_CRC, payload, 2, reply) || reply.length < 3) {
+			++failed;
+			continue;
+		}
+		const uint16_t	node_crc = reply.payload[1] | (reply.payload[2] << 8);
+		if (node_crc != crc) {
+			fprintf(stderr, "node %u: CRC 0x%04X, expected 0x%04X\n", nodes[i], node_crc, crc);
+			++failed;
+			continue;
+		}
+		if (!request(nodes[i], BOOT_CMD_RUN, 0, 0, reply)) {
+			++failed;
+			continue;
+		}
+		fprintf(stderr, "node %u: verified, running\n", nodes[i]);
+	}
+	close(port);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Simulated node for the serial bootloader: runs Micro/bootloader.c against an emulated flash
+ * and page buffer behind a pseudo-terminal, so that bootflash can be tested without hardware.
+ * Erase and write take 4 ms each, as on the AVR; the page buffer accepts each word only once.
+ *
+ * Usage:
+ *   bootsim [-a node] [-p page_size] [-e app_end] [-o image]
+ * Prints the name of the pseudo-terminal, then serves requests until BOOT_CMD_RUN, and writes
+ * the application flash to the image file.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <Micro/bootloader.h>
+
+/// Emulated flash, page buffer and its fill marks.
+static std::vector<uint8_t>	flash;
+static std::vector<uint8_t>	page_buffer;
+static std::vector<bool>	filled;
+static unsigned				page_size = 256;
+/// End of the current erase or write, microseconds.
+static unsigned long long	busy_until = 0;
+static int					pty = -1;
+static unsigned long		fill_violations = 0;
+
+/*****************************************************************************/
+static unsigned long long
+now_us()
+{
+	struct timeval	tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/*****************************************************************************/
+void
+bootloader_port_fill(
+	const uint16_t	address,
+	const uint8_t*	data,
+	const uint8_t	length
+)
+{
+	const unsigned	offset = address & (page_size - 1);
+	if (offset == 0) {
+		std::fill(page_buffer.begin(), page_buffer.end(), 0xFF);
+		std::fill(filled.begin(), filled.end(), false);
+	}
+	for (unsigned i=0; i<length; ++i) {
+		if (filled[offset + i]) {
+			++fill_violations;
+		}
+		page_buffer[offset + i] = data[i];
+		filled[offset + i] = true;
+	}
+}
+
+/*****************************************************************************/
+void
+bootloader_port_erase(
+	const uint16_t	address
+)
+{
+	std::fill(flash.begin() + address, flash.begin() + address + page_size, 0xFF);
+	busy_until = now_us() + 4000;
+}
+
+/*****************************************************************************/
+void
+bootloader_port_write(
+	const uint16_t	address
+)
+{
+	for (unsigned i=0; i<page_size; ++i) {
+		flash[address + i] &= page_buffer[i];
+	}
+	std::fill(filled.begin(), filled.end(), false);
+	busy_until = now_us() + 4000;
+}
+
+/*****************************************************************************/
+bool
+bootloader_port_busy(void)
+{
+	return now_us() < busy_until;
+}
+
+/*****************************************************************************/
+uint8_t
+bootloader_port_read(
+	const uint16_t	address
+)
+{
+	return flash[address];
+}
+
+/*****************************************************************************/
+void
+bootloader_port_putchar(
+	const uint8_t	c
+)
+{
+	if (write(pty, &c, 1) != 1) {
+		perror("write");
+	}
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	unsigned	node = 1;
+	unsigned	app_end = 0xF000;
+	const char*	output = "bootsim.bin";
+
+	for (int i=1; i+1<argc; i+=2) {
+		if (strcmp(argv[i], "-a") == 0) {
+			node = strtoul(argv[i + 1], 0, 0);
+		} else if (strcmp(argv[i], "-p") == 0) {
+			page_size = strtoul(argv[i + 1], 0, 0);
+		} else if (strcmp(argv[i], "-e") == 0) {
+			app_end = strtoul(argv[i + 1], 0, 0);
+		} else if (strcmp(argv[i], "-o") == 0) {
+			output = argv[i + 1];
+		}
+	}
+
+	flash.assign(app_end, 0xFF);
+	page_buffer.assign(page_size, 0xFF);
+	filled.assign(page_size, false);
+
+	pty = posix_openpt(O_RDWR | O_NOCTTY);
+	if (pty < 0 || grantpt(pty) != 0 || unlockpt(pty) != 0) {
+		perror("pty");
+		return 1;
+	}
+	struct termios	tio;
+	tcgetattr(pty, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(pty, TCSANOW, &tio);
+	printf("%s\n", ptsname(pty));
+	fflush(stdout);
+
+	bootloader_init(node, page_size, app_end);
+	bool	run = false;
+	while (!run) {
+		struct pollfd	pfd;
+		pfd.fd = pty;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 1) > 0 && (pfd.revents & POLLIN)) {
+			uint8_t			buffer[256];
+			const ssize_t	n = read(pty, buffer, sizeof(buffer));
+			for (ssize_t i=0; i<n && !run; ++i) {
+				bootloader_input(buffer[i]);
+				// The AVR processes requests while receiving; so must the simulation.
+				run = bootloader_poll() == BOOTLOADER_RUN;
+			}
+		}
+		if (!run) {
+			run = bootloader_poll() == BOOTLOADER_RUN;
+		}
+	}
+
+	// Let the reply go out before the pseudo-terminal closes.
+	usleep(100000);
+
+	FILE*	f = fopen(output, "wb");
+	if (f == 0) {
+		perror(output);
+		return 1;
+	}
+	fwrite(&flash[0], 1, flash.size(), f);
+	fclose(f);
+	fprintf(stderr, "bootsim: run, image in %s, %lu page buffer violations\n", output, fill_violations);
+	return fill_violations == 0 ? 0 : 1;
+}
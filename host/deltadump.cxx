@@ -0,0 +1,106 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Decode a delta-compressed sample stream (see Micro/deltacodec.h) and print one sample
+ * per line.
+ *
+ * Usage:
+ *   deltadump [file]	Decode file, or standard input when no file is given.
+ *   deltadump -b [noise]	Encode a synthetic stream with the given RMS noise (LSB) and report
+ *   						the compression ratio against println_hex32 and raw binary.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include <Micro/deltacodec.h>
+
+/*****************************************************************************/
+static int
+decode(
+	FILE*	f
+)
+{
+	DELTACODEC_DECODER	dec;
+	deltacodec_decoder_init(&dec);
+
+	int	c;
+	while ((c = fgetc(f)) != EOF) {
+		int32_t	sample;
+		if (deltacodec_decode(&dec, static_cast<uint8_t>(c), &sample)) {
+			printf("%ld\n", static_cast<long>(sample));
+		}
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+static int
+benchmark(
+	const double	noise
+)
+{
+	const unsigned	n = 100000;
+	std::mt19937	rng(1);
+	std::normal_distribution<double>	gauss(0.0, noise);
+
+	DELTACODEC_ENCODER	enc;
+	DELTACODEC_DECODER	dec;
+	deltacodec_encoder_init(&enc, 256);
+	deltacodec_decoder_init(&dec);
+
+	unsigned long	bytes = 0;
+	for (unsigned i=0; i<n; ++i) {
+		// Slow drift (at most 10 LSB per sample) plus noise, 24-bit signed.
+		const int32_t	sample = static_cast<int32_t>(
+			10000.0 * std::sin(i * 1e-3) + gauss(rng));
+		uint8_t			buffer[DELTACODEC_MAX_BYTES];
+		const uint8_t	len = deltacodec_encode(&enc, sample, buffer);
+		bytes += len;
+
+		int32_t	decoded = 0;
+		bool	ok = false;
+		for (uint8_t j=0; j<len; ++j) {
+			ok = deltacodec_decode(&dec, buffer[j], &decoded);
+		}
+		if (!ok || decoded != sample) {
+			fprintf(stderr, "Mismatch at sample %u: %ld != %ld\n", i,
+				static_cast<long>(decoded), static_cast<long>(sample));
+			return 1;
+		}
+	}
+
+	const double	per_sample = static_cast<double>(bytes) / n;
+	printf("noise %.1f LSB: %.2f bytes/sample, %.1fx vs println_hex32 (12), %.1fx vs raw (3)\n",
+		noise, per_sample, 12.0 / per_sample, 3.0 / per_sample);
+	return 0;
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+		return benchmark(argc >= 3 ? atof(argv[2]) : 8.0);
+	}
+	if (argc >= 2) {
+		FILE*	f = fopen(argv[1], "rb");
+		if (f == 0) {
+			perror(argv[1]);
+			return 1;
+		}
+		const int	r = decode(f);
+		fclose(f);
+		return r;
+	}
+	return decode(stdin);
+}
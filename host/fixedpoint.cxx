@@ -0,0 +1,154 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Error table of Micro/fixedpoint.h against libm: every function is evaluated over its whole
+ * input range (exhaustively where practical) and compared with the double result.
+ *
+ * Usage:
+ *   fixedpoint
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include <Micro/fixedpoint.h>
+
+/// Compile-time checks of the table generators and constants.
+static_assert(Q15::FromDouble(0.5).Raw() == 16384, "Q15 constant");
+static_assert(Q15::FromDouble(1.0).Raw() == 32767, "Q15 saturation");
+static_assert((Q15::FromDouble(-1.0) * Q15::FromDouble(-1.0)).Raw() == 32767, "Q15 -1*-1");
+static_assert((Q16_16::FromInt(3) / Q16_16::FromInt(2)).Raw() == 98304, "Q16_16 division");
+static_assert(fixed_cx_sqrt(2.0) > 1.41421356 && fixed_cx_sqrt(2.0) < 1.41421357, "constexpr sqrt");
+
+/** Polynomial for the test: 1 + x + x^2/2 + x^3/6 (exp, truncated), Q8_8 coefficients. */
+static const int16_t	poly_coeffs[] PROGMEM = {
+	Q8_8::Constant(1.0 / 6), Q8_8::Constant(0.5), Q8_8::Constant(1.0), Q8_8::Constant(1.0)
+};
+
+/*****************************************************************************/
+/** Running error statistics, in units of the output LSB. */
+struct Error {
+	double	max;
+	double	sum2;
+	long	n;
+
+	Error() : max(0), sum2(0), n(0) { }
+
+	void
+	Add(
+		const double	e
+	)
+	{
+		if (std::fabs(e) > max) {
+			max = std::fabs(e);
+		}
+		sum2 += e * e;
+		++n;
+	}
+
+	void
+	Print(
+		const char*	name,
+		const char*	unit,
+		const char*	domain
+	) const
+	{
+		printf("%-22s %10.3g %10.3g %-8s %s\n", name, max, std::sqrt(sum2 / n), unit, domain);
+	}
+};
+
+/*****************************************************************************/
+int
+main()
+{
+	printf("%-22s %10s %10s %-8s %s\n", "function", "max", "rms", "unit", "domain");
+
+	Error	sin_e;
+	Error	cos_e;
+	for (long a=0; a<65536; ++a) {
+		const double	t = 2 * M_PI * a / 65536.0;
+		sin_e.Add(fixed_sin(a).Raw() - 32767.0 * std::sin(t));
+		cos_e.Add(fixed_cos(a).Raw() - 32767.0 * std::cos(t));
+	}
+	sin_e.Print("fixed_sin", "LSB Q15", "all 65536 angles");
+	cos_e.Print("fixed_cos", "LSB Q15", "all 65536 angles");
+
+	Error	isqrt_e;
+	for (uint32_t x=0; x<(1UL << 24); x+=7) {
+		isqrt_e.Add(fixed_isqrt(x) - std::floor(std::sqrt((double)x)));
+	}
+	for (uint32_t x=0xFFFFFFFFUL; x>0xFFFFFFFFUL - 1000000UL; --x) {
+		isqrt_e.Add(fixed_isqrt(x) - std::floor(std::sqrt((double)x)));
+	}
+	isqrt_e.Print("fixed_isqrt", "LSB", "0..2^24, top of range");
+
+	Error	sqrt_e;
+	Error	sqrt_large_e;
+	for (int32_t raw=1; raw>0 && raw<0x7FFFFFFF - 4099; raw+=4099) {
+		const Q16_16	x = Q16_16::FromRaw(raw);
+		const double	exact = 65536.0 * std::sqrt(x.ToDouble());
+		if (raw < 0x10000) {
+			sqrt_e.Add(fixed_sqrt(x).Raw() - exact);
+		} else {
+			sqrt_large_e.Add((fixed_sqrt(x).Raw() - exact) / exact);
+		}
+	}
+	for (int32_t raw=1; raw<0x10000; ++raw) {
+		sqrt_e.Add(fixed_sqrt(Q16_16::FromRaw(raw)).Raw() - 65536.0 * std::sqrt(raw / 65536.0));
+	}
+	sqrt_e.Print("fixed_sqrt Q16_16", "LSB", "0..1");
+	sqrt_large_e.Print("fixed_sqrt Q16_16", "relative", "1..32768");
+
+	Error	recip_e;
+	Error	recip_small_e;
+	for (int32_t raw=3; raw>0 && raw<0x7FFFFFFF - 1009; raw+=1009) {
+		const Q16_16	x = Q16_16::FromRaw(raw);
+		const double	exact = 1.0 / x.ToDouble();
+		if (exact >= 1.0 && exact < 32767) {
+			recip_e.Add((fixed_reciprocal(x).ToDouble() - exact) / exact);
+			recip_e.Add((fixed_reciprocal(-x).ToDouble() + exact) / exact);
+		} else if (exact < 1.0) {
+			recip_small_e.Add(fixed_reciprocal(x).Raw() - 65536.0 * exact);
+		}
+	}
+	recip_e.Print("fixed_reciprocal", "relative", "1 <= |1/x| < 32767");
+	recip_small_e.Print("fixed_reciprocal", "LSB", "|1/x| < 1");
+
+	Error	poly_e;
+	for (int16_t raw=-512; raw<=512; ++raw) {
+		const Q8_8		x = Q8_8::FromRaw(raw);
+		const double	d = x.ToDouble();
+		const double	exact = Q8_8::Constant(1.0 / 6) / 256.0 * d * d * d + 0.5 * d * d + d + 1;
+		poly_e.Add(fixed_poly_P(poly_coeffs, 4, x).Raw() - 256.0 * exact);
+	}
+	poly_e.Print("fixed_poly_P cubic", "LSB Q8_8", "-2..2");
+
+	Error	mul15_e;
+	for (long a=-32768; a<32768; a+=37) {
+		for (long b=-32768; b<32768; b+=41) {
+			const double	exact = (double)a * b / 32768.0;
+			if (exact < 32767.5) {
+				mul15_e.Add((Q15::FromRaw(a) * Q15::FromRaw(b)).Raw() - exact);
+			}
+		}
+	}
+	mul15_e.Print("Q15 *", "LSB", "grid");
+
+	Error	div_e;
+	for (long a=-100000; a<100000; a+=97) {
+		for (long b=-100000; b<100000; b+=1013) {
+			if (b == 0) {
+				continue;
+			}
+			const double	exact = (double)a * 65536.0 / b;
+			if (std::fabs(exact) < 2147483647.0) {
+				div_e.Add((Q16_16::FromRaw(a) / Q16_16::FromRaw(b)).Raw() - exact);
+			}
+		}
+	}
+	div_e.Print("Q16_16 /", "LSB", "grid");
+	return 0;
+}
@@ -0,0 +1,1145 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Capture gateway: reads the output of several nodes from serial ports (or pseudo-terminals)
+ * with epoll, decodes it into typed records and appends them to a memory-mapped log of fixed
+ * size records with a time index.
+ *
+ * Decoded from each port:
+ * <ol>
+ *   <li>Text lines "name:value\r\n" of println_hex08/16/32, println_u16/u32, println_P.
+ *   <li>Acquisition batches, 0xA5 (Micro/acquisition.h).
+ *   <li>Interrupt trace batches, 0xA6, and statistics, 0xA7 (Micro/isrtrace.h).
+ *   <li>Frames, 0x7E (Micro/frame.h); text must not contain '~'.
+ * </ol>
+ * Other bytes are counted as garbage. Records get the host time of the read that completed them,
+ * from CLOCK_MONOTONIC: a step of the system clock, i.e. by NTP, does not disturb the order of
+ * the records that the index relies on. The header holds the wall clock time of the start.
+ *
+ * Log files, all fields little-endian:
+ * <ol>
+ *   <li>NAME.dat: 4096-byte header (see LOG_HEADER), followed by 64-byte records (see RECORD).
+ *   The record count in the header is updated after every read, so that the file can be
+ *   followed while capturing.
+ *   <li>NAME.idx: one INDEX_ENTRY (host time, record number) per INDEX_EVERY records, for
+ *   seeking by time.
+ * </ol>
+ *
+ * Usage:
+ *   gateway [-b baud] [-o name] port...	Capture until interrupted or all ports have closed.
+ *   										A regular file instead of a port is decoded as a raw
+ *   										capture. Default name: gateway.
+ *   gateway -r name [-s seconds] [-t type]	Replay a log as text, from the given number of
+ *   										seconds after the start, only records of the given type.
+ *   gateway -B ports [-d seconds] [-o name]	Benchmark: stream synthetic node output through
+ *   										the given number of pseudo-terminals as fast as possible
+ *   										and check that every record arrives.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Micro/crc.h>
+#include <Micro/frame.h>
+
+/// Batch and statistics markers, see Micro/acquisition.h and Micro/isrtrace.h.
+#define	ACQUISITION_START	0xA5
+#define	ISRTRACE_START		0xA6
+#define	ISRTRACE_STATS		0xA7
+
+/// Longest text line kept, longer lines are garbage.
+#define	LINE_MAX			80
+/// Records per index entry.
+#define	INDEX_EVERY			1024
+/// Largest number of ports.
+#define	PORTS_MAX			32
+
+/** Record types. */
+enum {
+	RECORD_TEXT = 1,
+	RECORD_SAMPLE,
+	RECORD_ISR,
+	RECORD_ISR_STATS,
+	RECORD_FRAME,
+	RECORD_TYPES
+};
+
+/** Flags of text records. */
+enum {
+	/** Value is a decimal number, in \c decimal. */
+	TEXT_DECIMAL	= 0x01,
+	/** Value is a hexadecimal number, in \c hex. */
+	TEXT_HEX		= 0x02
+};
+
+/** One record of the log, 64 bytes. */
+struct RECORD {
+	/** Host time, CLOCK_MONOTONIC nanoseconds. */
+	uint64_t	time_ns;
+	/** Record number of this port. */
+	uint32_t	sequence;
+	/** Port, index into LOG_HEADER::ports. */
+	uint16_t	port;
+	/** Record type, RECORD_*. */
+	uint8_t		type;
+	/** Bytes of payload used; for frames, the frame length. */
+	uint8_t		length;
+	union {
+		/** Text line. Name is truncated to 22 characters, value to 15. */
+		struct {
+			char		name[23];
+			uint8_t		flags;
+			char		value[16];
+			uint32_t	decimal;
+			uint32_t	hex;
+		} text;
+		/** Acquisition sample. */
+		struct {
+			uint32_t	timestamp;
+			uint32_t	value;
+		} sample;
+		/** Interrupt trace record. */
+		struct {
+			uint8_t		id;
+			uint8_t		reserved;
+			uint16_t	start;
+			uint16_t	duration;
+		} isr;
+		/** Interrupt statistics. */
+		struct {
+			uint8_t		id;
+			uint8_t		reserved;
+			uint16_t	clock_div;
+			uint32_t	count;
+			uint16_t	min;
+			uint16_t	max;
+			uint32_t	total;
+			uint16_t	latency;
+		} stats;
+		/** Frame. Payload is truncated to 45 bytes. */
+		struct {
+			uint8_t		address;
+			uint8_t		command;
+			uint8_t		reserved;
+			uint8_t		payload[45];
+		} frame;
+		uint8_t		raw[48];
+	};
+};
+
+/** Header of the log. */
+struct LOG_HEADER {
+	/** "MGWLOG2". */
+	char		magic[8];
+	/** sizeof(RECORD). */
+	uint32_t	record_size;
+	/** INDEX_EVERY. */
+	uint32_t	index_every;
+	/** Number of records. */
+	uint64_t	count;
+	/** Host time of the start, nanoseconds since the epoch. */
+	uint64_t	start_ns;
+	/** Host time of the start, CLOCK_MONOTONIC nanoseconds, as in the records. */
+	uint64_t	start_mono_ns;
+	/** Number of ports. */
+	uint32_t	nports;
+	uint32_t	reserved;
+	/** Port names. */
+	char		ports[PORTS_MAX][64];
+};
+
+/** Index entry. */
+struct INDEX_ENTRY {
+	/** Host time of the record, CLOCK_MONOTONIC nanoseconds. */
+	uint64_t	time_ns;
+	/** Record number. */
+	uint64_t	record;
+};
+
+#define	HEADER_SIZE		4096
+
+static_assert(sizeof(RECORD) == 64, "RECORD must be 64 bytes");
+static_assert(sizeof(LOG_HEADER) <= HEADER_SIZE, "LOG_HEADER too big");
+
+static const char*	type_names[RECORD_TYPES] = { "?", "text", "sample", "isr", "isrstats", "frame" };
+
+static volatile sig_atomic_t	stop = 0;
+
+/*****************************************************************************/
+static void
+on_signal(
+	int	sig
+)
+{
+	stop = 1;
+}
+
+/*****************************************************************************/
+/** Monotonic time, nanoseconds; for records, the index and intervals. */
+static uint64_t
+now_ns()
+{
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****************************************************************************/
+/** Wall clock time, nanoseconds since the epoch. */
+static uint64_t
+realtime_ns()
+{
+	struct timespec	ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****************************************************************************/
+static unsigned
+u16(
+	const uint8_t*	p
+)
+{
+	return p[0] | (p[1] << 8);
+}
+
+/*****************************************************************************/
+static uint32_t
+u32(
+	const uint8_t*	p
+)
+{
+	return u16(p) | (static_cast<uint32_t>(u16(p + 2)) << 16);
+}
+
+/*****************************************************************************/
+static speed_t
+speed_of(
+	const unsigned long	b
+)
+{
+	switch (b) {
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	case 460800:	return B460800;
+	case 500000:	return B500000;
+	case 921600:	return B921600;
+	case 1000000:	return B1000000;
+	case 2000000:	return B2000000;
+	default:
+		fprintf(stderr, "Unsupported baud rate %lu\n", b);
+		exit(1);
+	}
+}
+
+/*****************************************************************************/
+/** File mapped into memory, grown in steps while appending. */
+class MappedFile {
+public:
+	MappedFile() : fd(-1), base(0), capacity(0) { }
+
+	bool
+	create(
+		const std::string&	filename,
+		const size_t		initial
+	)
+	{
+		fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(filename.c_str());
+			return false;
+		}
+		return grow(initial);
+	}
+
+	bool
+	open_read(
+		const std::string&	filename
+	)
+	{
+		fd = open(filename.c_str(), O_RDONLY);
+		struct stat	st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			perror(filename.c_str());
+			return false;
+		}
+		capacity = st.st_size;
+		if (capacity > 0) {
+			base = static_cast<uint8_t*>(mmap(0, capacity, PROT_READ, MAP_SHARED, fd, 0));
+			if (base == MAP_FAILED) {
+				perror(filename.c_str());
+				base = 0;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Make sure that \c size bytes are mapped; doubles the file when needed. */
+	bool
+	reserve(
+		const size_t	size
+	)
+	{
+		return size <= capacity || grow(std::max(size, capacity * 2));
+	}
+
+	/** Truncate to \c size bytes and unmap. */
+	void
+	close_at(
+		const size_t	size
+	)
+	{
+		if (base != 0) {
+			munmap(base, capacity);
+			base = 0;
+		}
+		if (fd >= 0) {
+			if (ftruncate(fd, size) != 0) {
+				perror("ftruncate");
+			}
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	uint8_t*
+	data() const
+	{
+		return base;
+	}
+
+	size_t
+	size() const
+	{
+		return capacity;
+	}
+
+private:
+	bool
+	grow(
+		const size_t	size
+	)
+	{
+		if (ftruncate(fd, size) != 0) {
+			perror("ftruncate");
+			return false;
+		}
+		void*	p = base == 0
+			? mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+			: mremap(base, capacity, size, MREMAP_MAYMOVE);
+		if (p == MAP_FAILED) {
+			perror("mmap");
+			return false;
+		}
+		base = static_cast<uint8_t*>(p);
+		capacity = size;
+		return true;
+	}
+
+	int			fd;
+	uint8_t*	base;
+	size_t		capacity;
+};
+
+/*****************************************************************************/
+/** Log writer: records and index. */
+class LogWriter {
+public:
+	LogWriter() : header(0), count(0) { }
+
+	bool
+	create(
+		const std::string&				name,
+		const std::vector<std::string>&	ports
+	)
+	{
+		if (!dat.create(name + ".dat", HEADER_SIZE + 65536 * sizeof(RECORD))
+			|| !idx.create(name + ".idx", 4096 * sizeof(INDEX_ENTRY))) {
+			return false;
+		}
+		header = reinterpret_cast<LOG_HEADER*>(dat.data());
+		memcpy(header->magic, "MGWLOG2", 8);
+		header->record_size = sizeof(RECORD);
+		header->index_every = INDEX_EVERY;
+		header->count = 0;
+		header->start_ns = realtime_ns();
+		header->start_mono_ns = now_ns();
+		header->nports = std::min<size_t>(ports.size(), PORTS_MAX);
+		for (unsigned i=0; i<header->nports; ++i) {
+			strncpy(header->ports[i], ports[i].c_str(), sizeof(header->ports[i]) - 1);
+		}
+		return true;
+	}
+
+	/** Get space for the next record; valid until the next call. */
+	RECORD*
+	append()
+	{
+		if (!dat.reserve(HEADER_SIZE + (count + 1) * sizeof(RECORD))) {
+			return 0;
+		}
+		header = reinterpret_cast<LOG_HEADER*>(dat.data());
+		RECORD*	r = reinterpret_cast<RECORD*>(dat.data() + HEADER_SIZE) + count;
+		memset(r, 0, sizeof(*r));
+		++count;
+		return r;
+	}
+
+	/** Publish the records appended so far, and index them. */
+	void
+	commit()
+	{
+		const RECORD*	records = reinterpret_cast<const RECORD*>(dat.data() + HEADER_SIZE);
+		for (uint64_t i=(header->count + INDEX_EVERY - 1) / INDEX_EVERY * INDEX_EVERY; i<count; i+=INDEX_EVERY) {
+			const size_t	n = i / INDEX_EVERY;
+			if (idx.reserve((n + 1) * sizeof(INDEX_ENTRY))) {
+				INDEX_ENTRY*	e = reinterpret_cast<INDEX_ENTRY*>(idx.data()) + n;
+				e->time_ns = records[i].time_ns;
+				e->record = i;
+			}
+		}
+		header->count = count;
+	}
+
+	void
+	close()
+	{
+		if (header != 0) {
+			commit();
+			header = 0;
+			dat.close_at(HEADER_SIZE + count * sizeof(RECORD));
+			idx.close_at((count + INDEX_EVERY - 1) / INDEX_EVERY * sizeof(INDEX_ENTRY));
+		}
+	}
+
+	uint64_t
+	records() const
+	{
+		return count;
+	}
+
+private:
+	MappedFile		dat;
+	MappedFile		idx;
+	LOG_HEADER*		header;
+	uint64_t		count;
+};
+
+/*****************************************************************************/
+/** Decoder of the output of one node. */
+class NodeDecoder {
+public:
+	NodeDecoder(
+		const uint16_t	port_
+	)
+		: bytes(0), garbage(0), port(port_), state(STATE_TEXT), need(0), frame_errors(0), sequence(0)
+	{
+		frame_decoder_init(&fdec);
+		std::fill(types, types + RECORD_TYPES, 0);
+	}
+
+	/** Decode a buffer, appending the records to the log. */
+	void
+	feed(
+		const uint8_t*	data,
+		const size_t	n,
+		const uint64_t	time_ns,
+		LogWriter&		log
+	)
+	{
+		bytes += n;
+		for (size_t i=0; i<n; ++i) {
+			const uint8_t	c = data[i];
+			switch (state) {
+			case STATE_TEXT:
+				if (c == ACQUISITION_START || c == ISRTRACE_START || c == ISRTRACE_STATS) {
+					discard_line();
+					binary.assign(1, c);
+					need = c == ISRTRACE_STATS ? 18 : 2;
+					state = STATE_BINARY;
+				} else if (c == FRAME_SYNC) {
+					discard_line();
+					frame_errors = fdec.errors;
+					frame_decode(&fdec, c);
+					state = STATE_FRAME;
+				} else if (c == '\n') {
+					text_record(time_ns, log);
+				} else if (c == '\r') {
+				} else if (c >= 0x20 && c < 0x7F && line.size() < LINE_MAX) {
+					line.push_back(c);
+				} else {
+					discard_line();
+					++garbage;
+				}
+				break;
+			case STATE_BINARY:
+				binary.push_back(c);
+				if (binary.size() == 2 && binary[0] != ISRTRACE_STATS) {
+					need = 2 + binary[1] * (binary[0] == ACQUISITION_START ? 8 : 5);
+				}
+				if (binary.size() >= need) {
+					binary_records(time_ns, log);
+					state = STATE_TEXT;
+				}
+				break;
+			case STATE_FRAME:
+				if (frame_decode(&fdec, c)) {
+					frame_record(time_ns, log);
+					state = STATE_TEXT;
+				} else if (fdec.errors != frame_errors) {
+					garbage += 1 + fdec.frame.length;
+					state = STATE_TEXT;
+				}
+				break;
+			}
+		}
+	}
+
+	/** Bytes received. */
+	uint64_t		bytes;
+	/** Bytes not decoded. */
+	uint64_t		garbage;
+	/** Records by type. */
+	uint64_t		types[RECORD_TYPES];
+
+private:
+	enum { STATE_TEXT, STATE_BINARY, STATE_FRAME };
+
+	RECORD*
+	record(
+		const uint8_t	type,
+		const uint64_t	time_ns,
+		LogWriter&		log
+	)
+	{
+		RECORD*	r = log.append();
+		if (r != 0) {
+			r->time_ns = time_ns;
+			r->sequence = sequence++;
+			r->port = port;
+			r->type = type;
+			++types[type];
+		}
+		return r;
+	}
+
+	void
+	discard_line()
+	{
+		garbage += line.size();
+		line.clear();
+	}
+
+	void
+	text_record(
+		const uint64_t	time_ns,
+		LogWriter&		log
+	)
+	{
+		RECORD*	r = record(RECORD_TEXT, time_ns, log);
+		if (r == 0) {
+			return;
+		}
+		const size_t		colon = line.rfind(':');
+		const std::string	name = line.substr(0, colon);
+		const std::string	value = colon == std::string::npos ? std::string() : line.substr(colon + 1);
+		name.copy(r->text.name, sizeof(r->text.name) - 1);
+		value.copy(r->text.value, sizeof(r->text.value) - 1);
+		if (!value.empty() && value.size() <= 10 && value.find_first_not_of("0123456789") == std::string::npos) {
+			r->text.flags |= TEXT_DECIMAL;
+			r->text.decimal = strtoul(value.c_str(), 0, 10);
+		}
+		if (!value.empty() && value.size() <= 8 && value.find_first_not_of("0123456789ABCDEF") == std::string::npos) {
+			r->text.flags |= TEXT_HEX;
+			r->text.hex = strtoul(value.c_str(), 0, 16);
+		}
+		r->length = std::min(line.size(), sizeof(r->raw));
+		line.clear();
+	}
+
+	void
+	binary_records(
+		const uint64_t	time_ns,
+		LogWriter&		log
+	)
+	{
+		const uint8_t*	p = &binary[0];
+		if (p[0] == ISRTRACE_STATS) {
+			RECORD*	r = record(RECORD_ISR_STATS, time_ns, log);
+			if (r != 0) {
+				r->length = 18;
+				r->stats.id = p[1];
+				r->stats.clock_div = u16(p + 2);
+				r->stats.count = u32(p + 4);
+				r->stats.min = u16(p + 8);
+				r->stats.max = u16(p + 10);
+				r->stats.total = u32(p + 12);
+				r->stats.latency = u16(p + 16);
+			}
+			return;
+		}
+		for (unsigned i=0; i<p[1]; ++i) {
+			if (p[0] == ACQUISITION_START) {
+				const uint8_t*	q = p + 2 + 8 * i;
+				RECORD*			r = record(RECORD_SAMPLE, time_ns, log);
+				if (r != 0) {
+					r->length = 8;
+					r->sample.timestamp = u32(q);
+					r->sample.value = u32(q + 4);
+				}
+			} else {
+				const uint8_t*	q = p + 2 + 5 * i;
+				RECORD*			r = record(RECORD_ISR, time_ns, log);
+				if (r != 0) {
+					r->length = 5;
+					r->isr.id = q[0];
+					r->isr.start = u16(q + 1);
+					r->isr.duration = u16(q + 3);
+				}
+			}
+		}
+	}
+
+	void
+	frame_record(
+		const uint64_t	time_ns,
+		LogWriter&		log
+	)
+	{
+		RECORD*	r = record(RECORD_FRAME, time_ns, log);
+		if (r != 0) {
+			r->length = fdec.frame.length;
+			r->frame.address = fdec.frame.address;
+			r->frame.command = fdec.frame.command;
+			memcpy(r->frame.payload, fdec.frame.payload,
+				std::min<size_t>(fdec.frame.length, sizeof(r->frame.payload)));
+		}
+	}
+
+	uint16_t				port;
+	uint8_t					state;
+	std::string				line;
+	std::vector<uint8_t>	binary;
+	size_t					need;
+	FRAME_DECODER			fdec;
+	uint16_t				frame_errors;
+	uint32_t				sequence;
+};
+
+/*****************************************************************************/
+/** One input. */
+struct PORT {
+	std::string		name;
+	int				fd;
+	bool			open;
+	NodeDecoder		decoder;
+
+	PORT(const std::string& name_, const int fd_, const uint16_t index)
+		: name(name_), fd(fd_), open(true), decoder(index) { }
+};
+
+/*****************************************************************************/
+static void
+make_raw(
+	const int			fd,
+	const unsigned long	baud
+)
+{
+	struct termios	tio;
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		if (baud != 0) {
+			cfsetispeed(&tio, speed_of(baud));
+			cfsetospeed(&tio, speed_of(baud));
+		}
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+}
+
+/*****************************************************************************/
+/** Read everything available on a port.
+ * \return		false when the port has closed.
+ */
+static bool
+read_port(
+	PORT&		port,
+	LogWriter&	log
+)
+{
+	uint8_t	buffer[16384];
+	for (;;) {
+		const ssize_t	n = read(port.fd, buffer, sizeof(buffer));
+		if (n > 0) {
+			port.decoder.feed(buffer, n, now_ns(), log);
+		} else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return true;
+		} else {
+			// End of file, or EIO of a pseudo-terminal whose master has closed.
+			return false;
+		}
+	}
+}
+
+/*****************************************************************************/
+/** Capture from all ports until stopped or all have closed.
+ * \param[in]	done	When not null, stop when it returns true.
+ */
+static void
+capture(
+	std::vector<PORT*>&	ports,
+	LogWriter&			log,
+	bool				(*done)(const std::vector<PORT*>&)
+)
+{
+	const int	ep = epoll_create1(0);
+	unsigned	open_ports = 0;
+	for (size_t i=0; i<ports.size(); ++i) {
+		struct epoll_event	ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, ports[i]->fd, &ev) == 0) {
+			++open_ports;
+		} else {
+			// Regular file: a raw capture, decoded in one go.
+			while (read_port(*ports[i], log)) {
+			}
+			log.commit();
+			close(ports[i]->fd);
+			ports[i]->open = false;
+		}
+	}
+
+	while (!stop && open_ports > 0 && !(done != 0 && done(ports))) {
+		struct epoll_event	events[PORTS_MAX];
+		const int			n = epoll_wait(ep, events, PORTS_MAX, 200);
+		for (int i=0; i<n; ++i) {
+			PORT&	port = *ports[events[i].data.u32];
+			if (!read_port(port, log)) {
+				epoll_ctl(ep, EPOLL_CTL_DEL, port.fd, 0);
+				close(port.fd);
+				port.open = false;
+				--open_ports;
+			}
+		}
+		log.commit();
+	}
+	close(ep);
+}
+
+/*****************************************************************************/
+static void
+print_stats(
+	const std::vector<PORT*>&	ports,
+	const LogWriter&			log
+)
+{
+	printf("%-24s %12s %10s", "port", "bytes", "garbage");
+	for (unsigned t=1; t<RECORD_TYPES; ++t) {
+		printf(" %10s", type_names[t]);
+	}
+	printf("\n");
+	for (size_t i=0; i<ports.size(); ++i) {
+		const NodeDecoder&	d = ports[i]->decoder;
+		printf("%-24s %12llu %10llu", ports[i]->name.c_str(),
+			static_cast<unsigned long long>(d.bytes), static_cast<unsigned long long>(d.garbage));
+		for (unsigned t=1; t<RECORD_TYPES; ++t) {
+			printf(" %10llu", static_cast<unsigned long long>(d.types[t]));
+		}
+		printf("\n");
+	}
+	printf("%llu records\n", static_cast<unsigned long long>(log.records()));
+}
+
+/*****************************************************************************/
+static int
+replay(
+	const std::string&	name,
+	const double		from_s,
+	const int			type
+)
+{
+	MappedFile	dat;
+	MappedFile	idx;
+	if (!dat.open_read(name + ".dat") || !idx.open_read(name + ".idx")) {
+		return 1;
+	}
+	const LOG_HEADER*	header = reinterpret_cast<const LOG_HEADER*>(dat.data());
+	if (dat.size() < HEADER_SIZE || memcmp(header->magic, "MGWLOG2", 8) != 0
+		|| header->record_size != sizeof(RECORD)) {
+		fprintf(stderr, "%s.dat: not a gateway log\n", name.c_str());
+		return 1;
+	}
+	const RECORD*	records = reinterpret_cast<const RECORD*>(dat.data() + HEADER_SIZE);
+	const uint64_t	count = std::min<uint64_t>(header->count, (dat.size() - HEADER_SIZE) / sizeof(RECORD));
+
+	// Seek by the index, then scan at most INDEX_EVERY records.
+	const uint64_t		from_ns = header->start_mono_ns + static_cast<uint64_t>(from_s * 1e9);
+	const INDEX_ENTRY*	index = reinterpret_cast<const INDEX_ENTRY*>(idx.data());
+	// The file is preallocated, zeros follow the entries written.
+	const size_t		entries = std::min<uint64_t>(idx.size() / sizeof(INDEX_ENTRY),
+		(count + INDEX_EVERY - 1) / INDEX_EVERY);
+	const INDEX_ENTRY*	e = std::lower_bound(index, index + entries, from_ns,
+		[](const INDEX_ENTRY& a, const uint64_t t) { return a.time_ns < t; });
+	uint64_t	i = e == index ? 0 : (e - 1)->record;
+	while (i < count && records[i].time_ns < from_ns) {
+		++i;
+	}
+
+	for (; i<count; ++i) {
+		const RECORD&	r = records[i];
+		if (type != 0 && r.type != type) {
+			continue;
+		}
+		const double	t = (r.time_ns - header->start_mono_ns) * 1e-9;
+		const char*		port = r.port < header->nports ? header->ports[r.port] : "?";
+		printf("%12.6f %s %u %s", t, port, r.sequence, r.type < RECORD_TYPES ? type_names[r.type] : "?");
+		switch (r.type) {
+		case RECORD_TEXT:
+			printf(" %s %s", r.text.name, r.text.value);
+			if (r.text.flags & TEXT_DECIMAL) {
+				printf(" dec=%lu", static_cast<unsigned long>(r.text.decimal));
+			}
+			if (r.text.flags & TEXT_HEX) {
+				printf(" hex=%lu", static_cast<unsigned long>(r.text.hex));
+			}
+			break;
+		case RECORD_SAMPLE:
+			printf(" %lu %ld", static_cast<unsigned long>(r.sample.timestamp),
+				static_cast<long>(static_cast<int32_t>(r.sample.value)));
+			break;
+		case RECORD_ISR:
+			printf(" %u %u %u", r.isr.id, r.isr.start, r.isr.duration);
+			break;
+		case RECORD_ISR_STATS:
+			printf(" %u div=%u count=%lu min=%u max=%u total=%lu latency=%u", r.stats.id,
+				r.stats.clock_div, static_cast<unsigned long>(r.stats.count), r.stats.min, r.stats.max,
+				static_cast<unsigned long>(r.stats.total), r.stats.latency);
+			break;
+		case RECORD_FRAME:
+			printf(" %u %u", r.frame.address, r.frame.command);
+			for (unsigned j=0; j<std::min<unsigned>(r.length, sizeof(r.frame.payload)); ++j) {
+				printf(" %02X", r.frame.payload[j]);
+			}
+			break;
+		}
+		printf("\n");
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/** Benchmark: output of one synthetic node, repeated. */
+struct SYNTHETIC {
+	std::vector<uint8_t>	bytes;
+	uint64_t				records;
+};
+
+static std::vector<std::atomic<uint64_t> >*	bench_sent = 0;
+static std::atomic<bool>					bench_writing(true);
+
+/// Destination of frame_put.
+static std::vector<uint8_t>*	frame_out = 0;
+
+/*****************************************************************************/
+static void
+frame_put(
+	const uint8_t	c
+)
+{
+	frame_out->push_back(c);
+}
+
+/*****************************************************************************/
+static SYNTHETIC
+synthetic_output()
+{
+	SYNTHETIC	s;
+	s.records = 0;
+	std::vector<uint8_t>&	b = s.bytes;
+	uint32_t	t = 0;
+	for (unsigned k=0; k<64; ++k) {
+		// Acquisition batch of 16 samples.
+		b.push_back(ACQUISITION_START);
+		b.push_back(16);
+		for (unsigned i=0; i<16; ++i) {
+			const uint32_t	v = 0x800000 + k * 16 + i;
+			t += 156;
+			for (unsigned j=0; j<4; ++j) {
+				b.push_back(t >> (8 * j));
+			}
+			for (unsigned j=0; j<4; ++j) {
+				b.push_back(v >> (8 * j));
+			}
+		}
+		s.records += 16;
+		// Text lines.
+		char	line[64];
+		snprintf(line, sizeof(line), "Count:%u\r\nStatus:%04X\r\n", k * 1000, k);
+		b.insert(b.end(), line, line + strlen(line));
+		s.records += 2;
+		// Interrupt trace batch of 4 records.
+		b.push_back(ISRTRACE_START);
+		b.push_back(4);
+		for (unsigned i=0; i<4; ++i) {
+			const uint8_t	r[5] = { static_cast<uint8_t>(i), static_cast<uint8_t>(k), 0, 20, 0 };
+			b.insert(b.end(), r, r + 5);
+		}
+		s.records += 4;
+		// Frame.
+		const uint8_t	payload[8] = { 1, 2, 3, 4, 5, 6, 7, static_cast<uint8_t>(k) };
+		frame_out = &b;
+		frame_send(frame_put, 1, 0x81, payload, sizeof(payload));
+		s.records += 1;
+	}
+	return s;
+}
+
+/*****************************************************************************/
+static void
+bench_writer(
+	const std::vector<int>&	masters,
+	const SYNTHETIC&		s,
+	const double			seconds
+)
+{
+	const uint64_t	end = now_ns() + static_cast<uint64_t>(seconds * 1e9);
+	std::vector<size_t>	offset(masters.size(), 0);
+	bool	finishing = false;
+	for (;;) {
+		// Finish the synthetic block being written, so that every record is complete.
+		finishing = finishing || now_ns() >= end;
+		bool	busy = false;
+		for (size_t i=0; i<masters.size(); ++i) {
+			if (finishing && offset[i] == 0) {
+				continue;
+			}
+			busy = true;
+			const ssize_t	n = write(masters[i], &s.bytes[offset[i]], s.bytes.size() - offset[i]);
+			if (n > 0) {
+				offset[i] += n;
+				(*bench_sent)[i] += n;
+				if (offset[i] == s.bytes.size()) {
+					offset[i] = 0;
+				}
+			}
+		}
+		if (finishing && !busy) {
+			break;
+		}
+		if (!busy) {
+			continue;
+		}
+		struct timespec	ts = { 0, 20000 };
+		nanosleep(&ts, 0);
+	}
+	bench_writing = false;
+}
+
+/*****************************************************************************/
+static bool
+bench_done(
+	const std::vector<PORT*>&	ports
+)
+{
+	if (bench_writing) {
+		return false;
+	}
+	for (size_t i=0; i<ports.size(); ++i) {
+		if (ports[i]->decoder.bytes < (*bench_sent)[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*****************************************************************************/
+static int
+benchmark(
+	const unsigned		nports,
+	const double		seconds,
+	const std::string&	name
+)
+{
+	std::vector<int>	masters;
+	std::vector<PORT*>	ports;
+	std::vector<std::string>	names;
+	for (unsigned i=0; i<nports; ++i) {
+		const int	master = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+			perror("posix_openpt");
+			return 1;
+		}
+		const std::string	slave_name = ptsname(master);
+		const int			slave = open(slave_name.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if (slave < 0) {
+			perror(slave_name.c_str());
+			return 1;
+		}
+		make_raw(slave, 0);
+		fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+		masters.push_back(master);
+		ports.push_back(new PORT(slave_name, slave, i));
+		names.push_back(slave_name);
+	}
+
+	LogWriter	log;
+	if (!log.create(name, names)) {
+		return 1;
+	}
+	const SYNTHETIC	s = synthetic_output();
+	std::vector<std::atomic<uint64_t> >	sent(nports);
+	for (unsigned i=0; i<nports; ++i) {
+		sent[i] = 0;
+	}
+	bench_sent = &sent;
+
+	const uint64_t	start = now_ns();
+	std::thread		writer(bench_writer, std::cref(masters), std::cref(s), seconds);
+	capture(ports, log, bench_done);
+	writer.join();
+	const double	elapsed = (now_ns() - start) * 1e-9;
+	log.close();
+
+	print_stats(ports, log);
+	uint64_t	bytes = 0;
+	uint64_t	garbage = 0;
+	uint64_t	expected = 0;
+	for (unsigned i=0; i<nports; ++i) {
+		bytes += ports[i]->decoder.bytes;
+		garbage += ports[i]->decoder.garbage;
+		expected += sent[i] / s.bytes.size() * s.records;
+	}
+	printf("%.2f s, %.2f MB/s, %.0f records/s; %.1f ports at 1 Mbaud (100 kB/s each)\n",
+		elapsed, bytes / elapsed * 1e-6, log.records() / elapsed, bytes / elapsed / 100000.0);
+	const bool	ok = log.records() == expected && garbage == 0;
+	printf("%s: %llu records expected, %llu decoded, %llu bytes garbage\n", ok ? "OK" : "FAILED",
+		static_cast<unsigned long long>(expected), static_cast<unsigned long long>(log.records()),
+		static_cast<unsigned long long>(garbage));
+
+	for (unsigned i=0; i<nports; ++i) {
+		close(masters[i]);
+		if (ports[i]->open) {
+			close(ports[i]->fd);
+		}
+		delete ports[i];
+	}
+	return ok ? 0 : 1;
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	unsigned long				baud = 0;
+	std::string					name = "gateway";
+	std::string					replay_name;
+	double						from_s = 0.0;
+	int							type = 0;
+	unsigned					bench_ports = 0;
+	double						bench_seconds = 5.0;
+	std::vector<std::string>	inputs;
+
+	for (int i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baud = strtoul(argv[++i], 0, 10);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			name = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			replay_name = argv[++i];
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			from_s = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			const char*	t = argv[++i];
+			for (int j=1; j<RECORD_TYPES; ++j) {
+				if (strcmp(t, type_names[j]) == 0) {
+					type = j;
+				}
+			}
+			if (type == 0) {
+				fprintf(stderr, "Unknown record type %s\n", t);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+			bench_ports = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			bench_seconds = atof(argv[++i]);
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (!replay_name.empty()) {
+		return replay(replay_name, from_s, type);
+	}
+	if (bench_ports > 0) {
+		return benchmark(std::min<unsigned>(bench_ports, PORTS_MAX), bench_seconds, name);
+	}
+	if (inputs.empty() || inputs.size() > PORTS_MAX) {
+		fprintf(stderr, "Usage: gateway [-b baud] [-o name] port...\n"
+			"       gateway -r name [-s seconds] [-t type]\n"
+			"       gateway -B ports [-d seconds] [-o name]\n");
+		return 1;
+	}
+
+	std::vector<PORT*>	ports;
+	for (size_t i=0; i<inputs.size(); ++i) {
+		const int	fd = open(inputs[i].c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+		const int	fd_read = fd >= 0 ? fd : open(inputs[i].c_str(), O_RDONLY | O_NONBLOCK);
+		if (fd_read < 0) {
+			perror(inputs[i].c_str());
+			return 1;
+		}
+		if (isatty(fd_read)) {
+			make_raw(fd_read, baud);
+		}
+		ports.push_back(new PORT(inputs[i], fd_read, i));
+	}
+
+	LogWriter	log;
+	if (!log.create(name, inputs)) {
+		return 1;
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	capture(ports, log, 0);
+	log.close();
+	print_stats(ports, log);
+	for (size_t i=0; i<ports.size(); ++i) {
+		if (ports[i]->open) {
+			close(ports[i]->fd);
+		}
+		delete ports[i];
+	}
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Decode an interrupt trace captured from the UART (see Micro/isrtrace.h) and render a timeline
+ * followed by per-vector statistics. Bytes outside trace batches and statistics are skipped.
+ *
+ * Usage:
+ *   isrtrace [-f MHz] [-d div] [file]	Decode file, or standard input when no file is given.
+ *   									-f: CPU clock, default 10 MHz.
+ *   									-d: CPU clocks per trace clock, when the capture has no
+ *   									statistics; default 64.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Micro/isrtrace.h>
+
+/*****************************************************************************/
+static const char*
+vector_name(
+	const unsigned	id
+)
+{
+	static const char*	names[ISRTRACE_USER] = {
+		"TWI", "USART_RX", "USART_UDRE", "USART_TX", "SPI_STC", "DAC_USART_TX",
+		"TIMER0_COMPA", "TIMER1_COMPA", "TIMER2_COMPA", "EE_READY",
+		"WDT", "PCINT_RXD"
+	};
+	static char			buffer[16];
+	if (id < ISRTRACE_USER) {
+		return names[id];
+	}
+	snprintf(buffer, sizeof(buffer), "USER%u", id - ISRTRACE_USER);
+	return buffer;
+}
+
+/*****************************************************************************/
+static unsigned
+u16(
+	const uint8_t*	p
+)
+{
+	return p[0] | (p[1] << 8);
+}
+
+/*****************************************************************************/
+static unsigned long
+u32(
+	const uint8_t*	p
+)
+{
+	return u16(p) | (static_cast<unsigned long>(u16(p + 2)) << 16);
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	double		mhz = 10.0;
+	unsigned	div = 64;
+	const char*	filename = 0;
+
+	for (int i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			mhz = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			div = atoi(argv[++i]);
+		} else {
+			filename = argv[i];
+		}
+	}
+
+	FILE*	f = filename ? fopen(filename, "rb") : stdin;
+	if (f == 0) {
+		perror(filename);
+		return 1;
+	}
+	std::vector<uint8_t>	data;
+	int	c;
+	while ((c = fgetc(f)) != EOF) {
+		data.push_back(static_cast<uint8_t>(c));
+	}
+	if (filename) {
+		fclose(f);
+	}
+
+	// Pass 1: split into records and statistics; the last statistics of each vector win.
+	std::vector<ISRTRACE_RECORD>			records;
+	std::map<unsigned, ISRTRACE_STATS>		stats;
+	size_t	skipped = 0;
+	for (size_t i=0; i<data.size(); ) {
+		const size_t	left = data.size() - i;
+		if (data[i] == 0xA6 && left >= 2 && left >= 2 + 5u * data[i + 1]) {
+			const unsigned	n = data[i + 1];
+			for (unsigned j=0; j<n; ++j) {
+				const uint8_t*	p = &data[i + 2 + 5 * j];
+				ISRTRACE_RECORD	r;
+				r.id = p[0];
+				r.start = u16(p + 1);
+				r.duration = u16(p + 3);
+				records.push_back(r);
+			}
+			i += 2 + 5 * n;
+		} else if (data[i] == 0xA7 && left >= 18) {
+			const uint8_t*	p = &data[i];
+			ISRTRACE_STATS	s;
+			div = u16(p + 2);
+			s.count = u32(p + 4);
+			s.min = u16(p + 8);
+			s.max = u16(p + 10);
+			s.total = u32(p + 12);
+			s.latency = u16(p + 16);
+			stats[p[1]] = s;
+			i += 18;
+		} else {
+			++skipped;
+			++i;
+		}
+	}
+
+	const double	us_per_clock = div / mhz;
+
+	// Pass 2: timeline. Entry times wrap at 16 bits; records are in order.
+	printf("%12s %8s  %-14s %9s\n", "start us", "gap us", "vector", "exec us");
+	unsigned long long	time = 0;
+	unsigned long long	previous_end = 0;
+	unsigned			previous_start = 0;
+	std::map<unsigned, double>	busy;
+	for (size_t i=0; i<records.size(); ++i) {
+		const ISRTRACE_RECORD&	r = records[i];
+		if (i > 0) {
+			time += static_cast<uint16_t>(r.start - previous_start);
+		}
+		previous_start = r.start;
+		const double	gap = i > 0 && time >= previous_end ? (time - previous_end) * us_per_clock : 0.0;
+		const double	exec = r.duration * us_per_clock;
+		busy[r.id] += exec;
+		std::string		bar(1 + r.duration / 2 > 40 ? 40 : 1 + r.duration / 2, '#');
+		printf("%12.1f %8.1f  %-14s %9.1f  %s\n", time * us_per_clock, gap,
+			vector_name(r.id), exec, bar.c_str());
+		previous_end = time + r.duration;
+	}
+
+	// Load over the traced span.
+	if (records.size() >= 2) {
+		const double	span = previous_end * us_per_clock;
+		printf("\n%lu records over %.1f us, %lu bytes skipped\n",
+			static_cast<unsigned long>(records.size()), span, static_cast<unsigned long>(skipped));
+		for (std::map<unsigned, double>::const_iterator it=busy.begin(); it!=busy.end(); ++it) {
+			printf("  %-14s %5.1f %% CPU\n", vector_name(it->first), 100.0 * it->second / span);
+		}
+	}
+
+	if (!stats.empty()) {
+		printf("\n%-14s %10s %9s %9s %9s %11s\n",
+			"vector", "count", "min us", "mean us", "max us", "latency us");
+		for (std::map<unsigned, ISRTRACE_STATS>::const_iterator it=stats.begin(); it!=stats.end(); ++it) {
+			const ISRTRACE_STATS&	s = it->second;
+			printf("%-14s %10lu %9.1f %9.1f %9.1f %11.1f\n", vector_name(it->first),
+				static_cast<unsigned long>(s.count),
+				s.min * us_per_clock,
+				s.count ? s.total * us_per_clock / s.count : 0.0,
+				s.max * us_per_clock,
+				s.latency / mhz);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,303 @@
+/*
+vim: ts=4
+vim: shiftwidth=4
+*/
+
+/** \file
+ * Register access to a node over a serial port (see Micro/uartreg.h).
+ *
+ * Usage:
+ *   regtool [options] [-n repeat] read first count
+ *   regtool [options] write first value...
+ *   regtool [options] [-n repeat] gather register...
+ *   regtool [options] scatter register=value...
+ * Options: -p port, -b baud, -a node, -w ms, -m max_payload. Defaults: /dev/ttyUSB0, 38400 baud,
+ * node 1, max_payload 64. max_payload is FRAME_MAX_PAYLOAD of the node's firmware; its decoder
+ * drops longer requests, thus they are refused here.
+ * Numbers are decimal or 0x hexadecimal. Node 255 broadcasts writes. Reads are printed one
+ * register per line, with the round trip time; -n repeats them.
+ *
+ * For nodes sleeping in power-down (Micro/power.h), -w sends a wake-up byte before each request
+ * and waits the given time, longer than the oscillator start-up of the node and shorter than its
+ * POWER_UART_AWAKE_MS.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <time.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <Micro/frame.h>
+#include <Micro/uartreg.h>
+
+/// Reply timeout, ms.
+#define	TIMEOUT_MS	500
+
+/// FRAME_MAX_PAYLOAD of the nodes, by default; regtool itself is built with a larger one.
+#define	NODE_MAX_PAYLOAD	64
+
+static int				port = -1;
+static FRAME_DECODER	dec;
+/// Wake-up time, ms; 0 for no wake-up byte.
+static unsigned			wake_ms = 0;
+
+/*****************************************************************************/
+static void
+put(
+	const uint8_t	c
+)
+{
+	if (write(port, &c, 1) != 1) {
+		perror("write");
+		exit(1);
+	}
+}
+
+/*****************************************************************************/
+/** Wake the node up: the start bit of a byte that the frame decoder ignores. */
+static void
+wake()
+{
+	if (wake_ms == 0) {
+		return;
+	}
+	put(0xFF);
+	tcdrain(port);
+	struct timespec	ts;
+	ts.tv_sec = wake_ms / 1000;
+	ts.tv_nsec = (wake_ms % 1000) * 1000000L;
+	nanosleep(&ts, 0);
+}
+
+/*****************************************************************************/
+static speed_t
+speed_of(
+	const unsigned long	b
+)
+{
+	switch (b) {
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	case 500000:	return B500000;
+	case 1000000:	return B1000000;
+	default:
+		fprintf(stderr, "Unsupported baud rate %lu\n", b);
+		exit(1);
+	}
+}
+
+/*****************************************************************************/
+static double
+now_ms()
+{
+	struct timeval	tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/*****************************************************************************/
+static unsigned
+number(
+	const char*	s
+)
+{
+	char*			end;
+	const unsigned	x = strtoul(s, &end, 0);
+	if (*end != 0 || x > 255) {
+		fprintf(stderr, "Bad number: %s\n", s);
+		exit(1);
+	}
+	return x;
+}
+
+/*****************************************************************************/
+/** Send a request and wait for the reply; not for broadcasts. */
+static bool
+request(
+	const uint8_t			node,
+	const uint8_t			command,
+	const std::vector<uint8_t>&	payload,
+	FRAME&					reply
+)
+{
+	wake();
+	frame_send(put, node, command, payload.data(), payload.size());
+	for (;;) {
+		struct pollfd	pfd;
+		pfd.fd = port;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, TIMEOUT_MS) <= 0) {
+			fprintf(stderr, "Node %u: no reply\n", node);
+			return false;
+		}
+		uint8_t		c;
+		if (read(port, &c, 1) != 1) {
+			return false;
+		}
+		if (frame_decode(&dec, c)
+			&& dec.frame.address == node
+			&& dec.frame.command == (command | UARTREG_REPLY)
+			&& dec.frame.length >= 1) {
+			reply = dec.frame;
+			if (reply.payload[0] != UARTREG_OK) {
+				fprintf(stderr, "Node %u: status %u\n", node, reply.payload[0]);
+				return false;
+			}
+			return true;
+		}
+	}
+}
+
+/*****************************************************************************/
+int
+main(
+	int		argc,
+	char**	argv
+)
+{
+	const char*		device = "/dev/ttyUSB0";
+	unsigned long	baud = 38400;
+	unsigned		node = 1;
+	unsigned		repeat = 1;
+	unsigned		max_payload = NODE_MAX_PAYLOAD;
+	int				i = 1;
+
+	for (; i<argc && argv[i][0] == '-'; ++i) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			device = argv[++i];
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baud = strtoul(argv[++i], 0, 10);
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			node = number(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			wake_ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			max_payload = atoi(argv[++i]);
+			if (max_payload < 2 || max_payload > FRAME_MAX_PAYLOAD) {
+				fprintf(stderr, "max_payload must be 2..%u\n", FRAME_MAX_PAYLOAD);
+				return 1;
+			}
+		} else {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (i + 1 >= argc) {
+		fprintf(stderr, "Usage: regtool [options] [-n repeat] read first count\n"
+			"       regtool [options] write first value...\n"
+			"       regtool [options] [-n repeat] gather register...\n"
+			"       regtool [options] scatter register=value...\n"
+			"Options: -p port, -b baud, -a node, -w wake-up ms, -m max_payload (%u)\n",
+			NODE_MAX_PAYLOAD);
+		return 1;
+	}
+
+	// Request payload, and the registers read.
+	const char*				verb = argv[i++];
+	uint8_t					command;
+	std::vector<uint8_t>	payload;
+	std::vector<uint8_t>	registers;
+	if (strcmp(verb, "read") == 0 && i + 2 == argc) {
+		command = UARTREG_CMD_READ;
+		payload.push_back(number(argv[i]));
+		payload.push_back(number(argv[i + 1]));
+		for (unsigned j=0; j<payload[1]; ++j) {
+			registers.push_back(payload[0] + j);
+		}
+	} else if (strcmp(verb, "write") == 0) {
+		command = UARTREG_CMD_WRITE;
+		for (; i<argc; ++i) {
+			payload.push_back(number(argv[i]));
+		}
+	} else if (strcmp(verb, "gather") == 0) {
+		command = UARTREG_CMD_GATHER;
+		for (; i<argc; ++i) {
+			payload.push_back(number(argv[i]));
+		}
+		registers = payload;
+	} else if (strcmp(verb, "scatter") == 0) {
+		command = UARTREG_CMD_SCATTER;
+		for (; i<argc; ++i) {
+			char*	eq = strchr(argv[i], '=');
+			if (eq == 0) {
+				fprintf(stderr, "Expected register=value: %s\n", argv[i]);
+				return 1;
+			}
+			*eq = 0;
+			payload.push_back(number(argv[i]));
+			payload.push_back(number(eq + 1));
+		}
+	} else {
+		fprintf(stderr, "Unknown command %s\n", verb);
+		return 1;
+	}
+	if (registers.size() > max_payload - 1) {
+		fprintf(stderr, "Too many registers, the node reads at most %u (FRAME_MAX_PAYLOAD %u, see -m)\n",
+			max_payload - 1, max_payload);
+		return 1;
+	}
+	if (payload.size() > max_payload) {
+		fprintf(stderr, "Request too long, the node takes at most %u bytes (FRAME_MAX_PAYLOAD, see -m)\n",
+			max_payload);
+		return 1;
+	}
+
+	port = open(device, O_RDWR | O_NOCTTY);
+	if (port < 0) {
+		perror(device);
+		return 1;
+	}
+	struct termios	tio;
+	tcgetattr(port, &tio);
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed_of(baud));
+	cfsetospeed(&tio, speed_of(baud));
+	tcsetattr(port, TCSANOW, &tio);
+	tcflush(port, TCIOFLUSH);
+	frame_decoder_init(&dec);
+
+	if (node == FRAME_BROADCAST) {
+		if (!registers.empty()) {
+			fprintf(stderr, "Reads cannot be broadcast\n");
+			return 1;
+		}
+		wake();
+		frame_send(put, node, command, payload.data(), payload.size());
+		tcdrain(port);
+		return 0;
+	}
+
+	for (unsigned r=0; r<(registers.empty() ? 1 : repeat); ++r) {
+		FRAME			reply;
+		const double	start = now_ms();
+		if (!request(node, command, payload, reply)) {
+			return 1;
+		}
+		const double	elapsed = now_ms() - start;
+		if (reply.length != registers.size() + 1) {
+			fprintf(stderr, "Node %u: reply of %u bytes\n", node, reply.length);
+			return 1;
+		}
+		for (size_t j=0; j<registers.size(); ++j) {
+			printf("%3u: 0x%02X %3u\n", registers[j], reply.payload[1 + j], reply.payload[1 + j]);
+		}
+		if (!registers.empty()) {
+			printf("%.1f ms\n", elapsed);
+		}
+	}
+	return 0;
+}